@@ -0,0 +1,637 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+/* Benchmark of the modulation and demodulation speed.
+ * For each configuration, some random data is modulated to a temporary file
+ * with the 'file=' radio type, then demodulated from this file, and each
+ * direction is timed separately. One line of comma separated values is
+ * printed for each direction.
+ * In latency mode, short messages are sent at regular intervals through
+ * a 'loopback=' link to a receiver running at the same time, and the time
+ * between the reading of each message by the transmitter and its delivery
+ * by the receiver is measured for several block durations.
+ * In audio mode, the Hilbert modem ('-a' of dsss-transfer) and the direct
+ * modem ('-A') are compared on audio samples, with the carrier at a
+ * quarter of the sample rate. */
+
+struct configuration_s
+{
+  unsigned int spreading_factor;
+  unsigned int bit_rate;
+  unsigned long int sample_rate;
+  char *inner_fec;
+  char *outer_fec;
+};
+
+/* Messages of the latency mode, containing their index */
+#define LATENCY_MESSAGE_SIZE 16
+#define LATENCY_INTERVAL 0.1
+
+struct latency_s
+{
+  unsigned int messages;
+  unsigned int sent;
+  double *send_times;
+  double next_time;
+  unsigned int received;
+  double sum;
+  double min;
+  double max;
+};
+
+struct context_s
+{
+  unsigned char *data;
+  unsigned int size;
+  unsigned int index;
+  unsigned int frames;
+  int ok;
+};
+
+unsigned int spreading_factors[] = { 2, 4, 8, 16, 32, 64 };
+unsigned int bit_rates[] = { 100, 1200, 9600, 50000 };
+unsigned long int sample_rates[] = { 1000000, 2000000, 4000000, 8000000 };
+char *fec_pairs[][2] =
+  {
+    { "none", "none" },
+    { "h128", "none" },
+    { "h74", "none" },
+    { "g2412", "none" },
+    { "v27", "none" },
+    { "v29", "rs8" }
+  };
+unsigned int block_durations[] = { 50, 20, 10, 5 };
+struct configuration_s reference = { 64, 1200, 2000000, "h128", "none" };
+unsigned int audio_bit_rates[] = { 100, 300, 600 };
+struct configuration_s audio_reference = { 16, 300, 48000, "h128", "none" };
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+float duration = 2;
+char *sample_format = "CF32";
+unsigned char fused_frontend = 0;
+unsigned int pipeline = 0;
+unsigned char audio = 0;
+unsigned char direct_audio = 0;
+
+int read_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int size = payload_size;
+
+  if(ctx->index == ctx->size)
+  {
+    return(-1);
+  }
+  if(ctx->index + size > ctx->size)
+  {
+    size = ctx->size - ctx->index;
+  }
+  memcpy(payload, ctx->data + ctx->index, size);
+  ctx->index += size;
+  ctx->frames++;
+
+  return(size);
+}
+
+int write_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  if((ctx->index + payload_size > ctx->size) ||
+     (memcmp(ctx->data + ctx->index, payload, payload_size) != 0))
+  {
+    ctx->ok = 0;
+  }
+  else
+  {
+    ctx->index += payload_size;
+  }
+  ctx->frames++;
+
+  return(payload_size);
+}
+
+double get_time()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return(now.tv_sec + now.tv_nsec / 1e9);
+}
+
+/* Give a message to the transmitter every LATENCY_INTERVAL seconds */
+int read_message(void *context,
+                 unsigned char *payload,
+                 unsigned int payload_size)
+{
+  struct latency_s *latency = (struct latency_s *) context;
+  double now = get_time();
+
+  /* A message that doesn't fit in the payload would be truncated, which
+   * would make its index unreadable */
+  if((latency->sent == latency->messages) ||
+     (payload_size < LATENCY_MESSAGE_SIZE))
+  {
+    return(-1);
+  }
+  if(now < latency->next_time)
+  {
+    /* Don't make the transmitter wait longer than a millisecond */
+    usleep(1000);
+    return(0);
+  }
+  memset(payload, 0, LATENCY_MESSAGE_SIZE);
+  memcpy(payload, &latency->sent, sizeof(latency->sent));
+  latency->send_times[latency->sent] = now;
+  latency->sent++;
+  latency->next_time = now + LATENCY_INTERVAL;
+
+  return(LATENCY_MESSAGE_SIZE);
+}
+
+int write_message(void *context,
+                  unsigned char *payload,
+                  unsigned int payload_size)
+{
+  struct latency_s *latency = (struct latency_s *) context;
+  double delay;
+  unsigned int index;
+
+  if(payload_size != LATENCY_MESSAGE_SIZE)
+  {
+    return(payload_size);
+  }
+  memcpy(&index, payload, sizeof(index));
+  if(index >= latency->messages)
+  {
+    return(payload_size);
+  }
+  delay = get_time() - latency->send_times[index];
+  latency->sum += delay;
+  if((latency->received == 0) || (delay < latency->min))
+  {
+    latency->min = delay;
+  }
+  if(delay > latency->max)
+  {
+    latency->max = delay;
+  }
+  latency->received++;
+
+  return(payload_size);
+}
+
+dsss_transfer_t create(struct configuration_s *configuration,
+                       char *radio,
+                       unsigned char emit,
+                       int (*callback)(void *, unsigned char *, unsigned int),
+                       void *context)
+{
+  dsss_transfer_t transfer;
+
+  transfer = dsss_transfer_create_callback(radio,
+                                           emit,
+                                           callback,
+                                           context,
+                                           configuration->sample_rate,
+                                           configuration->bit_rate,
+                                           audio ?
+                                           configuration->sample_rate / 4 :
+                                           434000000,
+                                           0,
+                                           "0",
+                                           0,
+                                           configuration->spreading_factor,
+                                           configuration->inner_fec,
+                                           configuration->outer_fec,
+                                           "",
+                                           NULL,
+                                           0,
+                                           audio);
+  if(transfer == NULL)
+  {
+    return(NULL);
+  }
+  if((dsss_transfer_set_sample_format(transfer, sample_format) < 0) ||
+     (direct_audio && (dsss_transfer_set_direct_audio(transfer, 1) < 0)))
+  {
+    dsss_transfer_free(transfer);
+    return(NULL);
+  }
+  dsss_transfer_set_fused_frontend(transfer, fused_frontend);
+  dsss_transfer_set_pipeline(transfer, pipeline);
+
+  return(transfer);
+}
+
+/* Run a transfer and return its duration in seconds, or a negative number
+ * if it could not be created */
+double run(struct configuration_s *configuration,
+           char *radio,
+           unsigned char emit,
+           struct context_s *context)
+{
+  dsss_transfer_t transfer;
+  double start;
+
+  transfer = create(configuration,
+                    radio,
+                    emit,
+                    emit ? read_data : write_data,
+                    context);
+  if(transfer == NULL)
+  {
+    return(-1);
+  }
+
+  start = get_time();
+  dsss_transfer_start(transfer);
+  dsss_transfer_free(transfer);
+
+  return(get_time() - start);
+}
+
+void print_result(struct configuration_s *configuration,
+                  char *direction,
+                  unsigned long long int samples,
+                  double seconds,
+                  struct context_s *context)
+{
+  printf("%s,%u,%u,%lu,%s,%s,%llu,%.3f,%.3f,%.2f,%.1f,%.1f,%d\n",
+         direction,
+         configuration->spreading_factor,
+         configuration->bit_rate,
+         configuration->sample_rate,
+         configuration->inner_fec,
+         configuration->outer_fec,
+         samples,
+         seconds,
+         samples / seconds / 1000000,
+         ((double) samples / configuration->sample_rate) / seconds,
+         context->frames / seconds,
+         context->index / seconds,
+         context->ok);
+  fflush(stdout);
+}
+
+void benchmark(struct configuration_s *configuration, char *samples_file)
+{
+  struct context_s context;
+  char radio[strlen(samples_file) + 6];
+  unsigned int size;
+  unsigned long long int samples;
+  struct stat samples_stat;
+  unsigned int sample_size;
+  char *modem = !audio ? "" : direct_audio ? "direct-audio-" : "audio-";
+  char direction[32];
+  double seconds;
+  unsigned int i;
+
+  /* The signal must fit in the band of the radio */
+  if(configuration->bit_rate * configuration->spreading_factor * 2 >
+     configuration->sample_rate)
+  {
+    return;
+  }
+
+  size = configuration->bit_rate * duration / 8;
+  size = (size < 64) ? 64 : size;
+  context.data = malloc(size);
+  if(context.data == NULL)
+  {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < size; i++)
+  {
+    context.data[i] = rand();
+  }
+  sprintf(radio, "file=%s", samples_file);
+
+  context.size = size;
+  context.index = 0;
+  context.frames = 0;
+  context.ok = 1;
+  seconds = run(configuration, radio, 1, &context);
+  if((seconds < 0) || (stat(samples_file, &samples_stat) != 0))
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    free(context.data);
+    return;
+  }
+  if(audio)
+  {
+    /* Audio samples are real, and CF32 selects 16 bit integers */
+    sample_size = (strcasecmp(sample_format, "F32") == 0) ? 4 : 2;
+  }
+  else
+  {
+    sample_size = (strcasecmp(sample_format, "CS8") == 0) ? 2 :
+      (strcasecmp(sample_format, "CS16") == 0) ? 4 :
+      8;
+  }
+  samples = samples_stat.st_size / sample_size;
+  sprintf(direction, "%smodulation", modem);
+  print_result(configuration, direction, samples, seconds, &context);
+
+  context.index = 0;
+  context.frames = 0;
+  context.ok = 1;
+  seconds = run(configuration, radio, 0, &context);
+  if(seconds < 0)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    free(context.data);
+    return;
+  }
+  context.ok = context.ok && (context.index == context.size);
+  sprintf(direction, "%sdemodulation", modem);
+  print_result(configuration, direction, samples, seconds, &context);
+
+  free(context.data);
+}
+
+void * receive_messages(void *arg)
+{
+  dsss_transfer_start((dsss_transfer_t) arg);
+
+  return(NULL);
+}
+
+void measure_latency(struct configuration_s *configuration,
+                     unsigned int block_duration)
+{
+  struct latency_s latency;
+  dsss_transfer_t transmitter;
+  dsss_transfer_t receiver;
+  pthread_t receiver_thread;
+  char *radio = "loopback=dsss-transfer-bench";
+
+  latency.messages = (duration / LATENCY_INTERVAL < 1) ?
+    1 :
+    duration / LATENCY_INTERVAL;
+  latency.sent = 0;
+  latency.send_times = malloc(latency.messages * sizeof(double));
+  latency.next_time = 0;
+  latency.received = 0;
+  latency.sum = 0;
+  latency.min = 0;
+  latency.max = 0;
+  if(latency.send_times == NULL)
+  {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+
+  receiver = create(configuration, radio, 0, write_message, &latency);
+  transmitter = create(configuration, radio, 1, read_message, &latency);
+  if((receiver == NULL) || (transmitter == NULL) ||
+     (dsss_transfer_set_durations(receiver, block_duration, 0) < 0) ||
+     (dsss_transfer_set_durations(transmitter, block_duration, 0) < 0) ||
+     (dsss_transfer_set_coalescing(transmitter, LATENCY_MESSAGE_SIZE, 0) < 0) ||
+     (pthread_create(&receiver_thread, NULL, receive_messages, receiver) != 0))
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    dsss_transfer_free(transmitter);
+    dsss_transfer_free(receiver);
+    free(latency.send_times);
+    return;
+  }
+  dsss_transfer_start(transmitter);
+  pthread_join(receiver_thread, NULL);
+  dsss_transfer_free(transmitter);
+  dsss_transfer_free(receiver);
+
+  printf("latency,%u,%u,%lu,%s,%s,%u,%u,%u,%.1f,%.1f,%.1f\n",
+         configuration->spreading_factor,
+         configuration->bit_rate,
+         configuration->sample_rate,
+         configuration->inner_fec,
+         configuration->outer_fec,
+         block_duration,
+         latency.messages,
+         latency.received,
+         latency.min * 1000,
+         (latency.received > 0) ? latency.sum * 1000 / latency.received : 0,
+         latency.max * 1000);
+  fflush(stdout);
+
+  free(latency.send_times);
+}
+
+void usage()
+{
+  printf("dsss-transfer-bench\n");
+  printf("\n");
+  printf("Usage: dsss-transfer-bench [options]\n");
+  printf("\n");
+  printf("Options:\n");
+  printf("  -a\n");
+  printf("    Benchmark all the combinations of parameters, instead of\n");
+  printf("    changing one parameter at a time from the reference\n");
+  printf("    configuration (n=64, b=1200, s=2000000, e=h128,none).\n");
+  printf("  -d <duration>  (default: 2 s)\n");
+  printf("    Duration of the transmission of each configuration.\n");
+  printf("  -D\n");
+  printf("    Use the fused front end to receive.\n");
+  printf("  -F <format>  (default: CF32)\n");
+  printf("    Format of the samples: CF32, CS16 or CS8.\n");
+  printf("  -h\n");
+  printf("    This help.\n");
+  printf("  -l\n");
+  printf("    Measure the latency between the transmitter reading a message\n");
+  printf("    and the receiver delivering it, through a 'loopback=' link\n");
+  printf("    (without air time), with the reference configuration and\n");
+  printf("    several block durations.\n");
+  printf("  -p <duration>  (default: 0 ms)\n");
+  printf("    Use the pipelined receiver with queues of 'duration' ms.\n");
+  printf("  -u\n");
+  printf("    Compare the Hilbert modem ('-a' of dsss-transfer) and the\n");
+  printf("    direct modem ('-A') on audio samples (n=16, s=48000,\n");
+  printf("    e=h128,none, and several bit rates). The format of the\n");
+  printf("    samples is then S16 or F32.\n");
+  printf("\n");
+  printf("Output columns:\n");
+  printf("  direction, spreading factor, bit rate, sample rate, inner FEC,\n");
+  printf("  outer FEC, samples, seconds, millions of samples per second,\n");
+  printf("  real-time factor, frames per second, bytes per second,\n");
+  printf("  1 if the data was received correctly\n");
+  printf("  In audio mode, the direction is prefixed with 'audio-' or\n");
+  printf("  'direct-audio-'.\n");
+  printf("Output columns in latency mode:\n");
+  printf("  'latency', spreading factor, bit rate, sample rate, inner FEC,\n");
+  printf("  outer FEC, block duration, messages sent, messages received,\n");
+  printf("  minimum, mean and maximum latency in milliseconds\n");
+}
+
+int main(int argc, char **argv)
+{
+  struct configuration_s configuration;
+  char samples_file[] = "/tmp/dsss-transfer-bench.XXXXXX";
+  int samples_fd;
+  int all = 0;
+  int latency = 0;
+  unsigned int i;
+  unsigned int j;
+  unsigned int k;
+  unsigned int l;
+  int opt;
+
+  while((opt = getopt(argc, argv, "ad:DF:hlp:u")) != -1)
+  {
+    switch(opt)
+    {
+    case 'a':
+      all = 1;
+      break;
+
+    case 'd':
+      duration = strtof(optarg, NULL);
+      break;
+
+    case 'D':
+      fused_frontend = 1;
+      break;
+
+    case 'F':
+      sample_format = optarg;
+      break;
+
+    case 'h':
+      usage();
+      return(EXIT_SUCCESS);
+
+    case 'l':
+      latency = 1;
+      break;
+
+    case 'p':
+      pipeline = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'u':
+      audio = 1;
+      break;
+
+    default:
+      fprintf(stderr, "Error: Unknown parameter: '-%c %s'\n", opt, optarg);
+      return(EXIT_FAILURE);
+    }
+  }
+
+  if(latency)
+  {
+    printf("mode,spreading_factor,bit_rate,sample_rate,inner_fec,outer_fec,"
+           "block_duration,sent,received,min_ms,mean_ms,max_ms\n");
+    for(i = 0; i < COUNT(block_durations); i++)
+    {
+      measure_latency(&reference, block_durations[i]);
+    }
+    return(EXIT_SUCCESS);
+  }
+
+  samples_fd = mkstemp(samples_file);
+  if(samples_fd == -1)
+  {
+    fprintf(stderr, "Error: Failed to create temporary file\n");
+    return(EXIT_FAILURE);
+  }
+  close(samples_fd);
+
+  printf("direction,spreading_factor,bit_rate,sample_rate,inner_fec,outer_fec,"
+         "samples,seconds,msps,realtime_factor,frames_per_second,"
+         "bytes_per_second,ok\n");
+
+  if(audio)
+  {
+    for(i = 0; i < COUNT(audio_bit_rates); i++)
+    {
+      configuration = audio_reference;
+      configuration.bit_rate = audio_bit_rates[i];
+      direct_audio = 0;
+      benchmark(&configuration, samples_file);
+      direct_audio = 1;
+      benchmark(&configuration, samples_file);
+    }
+  }
+  else if(all)
+  {
+    for(i = 0; i < COUNT(spreading_factors); i++)
+    {
+      for(j = 0; j < COUNT(bit_rates); j++)
+      {
+        for(k = 0; k < COUNT(sample_rates); k++)
+        {
+          for(l = 0; l < COUNT(fec_pairs); l++)
+          {
+            configuration.spreading_factor = spreading_factors[i];
+            configuration.bit_rate = bit_rates[j];
+            configuration.sample_rate = sample_rates[k];
+            configuration.inner_fec = fec_pairs[l][0];
+            configuration.outer_fec = fec_pairs[l][1];
+            benchmark(&configuration, samples_file);
+          }
+        }
+      }
+    }
+  }
+  else
+  {
+    for(i = 0; i < COUNT(spreading_factors); i++)
+    {
+      configuration = reference;
+      configuration.spreading_factor = spreading_factors[i];
+      benchmark(&configuration, samples_file);
+    }
+    for(i = 0; i < COUNT(bit_rates); i++)
+    {
+      configuration = reference;
+      configuration.bit_rate = bit_rates[i];
+      benchmark(&configuration, samples_file);
+    }
+    for(i = 0; i < COUNT(sample_rates); i++)
+    {
+      configuration = reference;
+      configuration.sample_rate = sample_rates[i];
+      benchmark(&configuration, samples_file);
+    }
+    for(i = 0; i < COUNT(fec_pairs); i++)
+    {
+      configuration = reference;
+      configuration.inner_fec = fec_pairs[i][0];
+      configuration.outer_fec = fec_pairs[i][1];
+      benchmark(&configuration, samples_file);
+    }
+  }
+
+  unlink(samples_file);
+
+  return(EXIT_SUCCESS);
+}
@@ -0,0 +1,243 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "delivery.h"
+
+struct payload_s
+{
+  delivery_callback callback;
+  void *context;
+  char id[5];
+  unsigned int size;
+  struct payload_s *next;
+  unsigned char data[];
+};
+
+struct delivery_s
+{
+  unsigned int max_bytes;
+  delivery_policy_t policy;
+  struct payload_s *first;
+  struct payload_s *last;
+  unsigned long long int queued_bytes;
+  unsigned long long int dropped_payloads;
+  unsigned long long int dropped_bytes;
+  int finished;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  /* Signaled when a payload is added, and when some room is made */
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+};
+
+void * delivery_writer(void *arg)
+{
+  delivery_t delivery = (delivery_t) arg;
+  struct payload_s *payload;
+
+  pthread_mutex_lock(&delivery->mutex);
+  while(1)
+  {
+    while((delivery->first == NULL) && !delivery->finished)
+    {
+      pthread_cond_wait(&delivery->not_empty, &delivery->mutex);
+    }
+    payload = delivery->first;
+    if(payload == NULL)
+    {
+      /* Finished and empty */
+      break;
+    }
+    delivery->first = payload->next;
+    if(delivery->first == NULL)
+    {
+      delivery->last = NULL;
+    }
+    pthread_mutex_unlock(&delivery->mutex);
+
+    payload->callback(payload->context,
+                      payload->id,
+                      payload->data,
+                      payload->size);
+
+    pthread_mutex_lock(&delivery->mutex);
+    /* The payload is counted until its callback returns */
+    delivery->queued_bytes -= payload->size;
+    pthread_cond_broadcast(&delivery->not_full);
+    free(payload);
+  }
+  pthread_mutex_unlock(&delivery->mutex);
+
+  return(NULL);
+}
+
+delivery_t delivery_create(unsigned int max_bytes, delivery_policy_t policy)
+{
+  delivery_t delivery = malloc(sizeof(struct delivery_s));
+
+  if(delivery == NULL)
+  {
+    return(NULL);
+  }
+  delivery->max_bytes = max_bytes;
+  delivery->policy = policy;
+  delivery->first = NULL;
+  delivery->last = NULL;
+  delivery->queued_bytes = 0;
+  delivery->dropped_payloads = 0;
+  delivery->dropped_bytes = 0;
+  delivery->finished = 0;
+  pthread_mutex_init(&delivery->mutex, NULL);
+  pthread_cond_init(&delivery->not_empty, NULL);
+  pthread_cond_init(&delivery->not_full, NULL);
+  if(pthread_create(&delivery->thread, NULL, delivery_writer, delivery) != 0)
+  {
+    pthread_cond_destroy(&delivery->not_full);
+    pthread_cond_destroy(&delivery->not_empty);
+    pthread_mutex_destroy(&delivery->mutex);
+    free(delivery);
+    return(NULL);
+  }
+
+  return(delivery);
+}
+
+void delivery_finish(delivery_t delivery)
+{
+  pthread_mutex_lock(&delivery->mutex);
+  delivery->finished = 1;
+  pthread_cond_broadcast(&delivery->not_empty);
+  pthread_mutex_unlock(&delivery->mutex);
+  pthread_join(delivery->thread, NULL);
+}
+
+void delivery_free(delivery_t delivery)
+{
+  if(delivery)
+  {
+    pthread_cond_destroy(&delivery->not_full);
+    pthread_cond_destroy(&delivery->not_empty);
+    pthread_mutex_destroy(&delivery->mutex);
+    free(delivery);
+  }
+}
+
+/* Remove the oldest payload waiting in the queue.
+ * The mutex must be held. */
+void drop_oldest(delivery_t delivery)
+{
+  struct payload_s *payload = delivery->first;
+
+  delivery->first = payload->next;
+  if(delivery->first == NULL)
+  {
+    delivery->last = NULL;
+  }
+  delivery->queued_bytes -= payload->size;
+  delivery->dropped_payloads++;
+  delivery->dropped_bytes += payload->size;
+  free(payload);
+}
+
+/* Count a payload that could not be queued.
+ * The mutex must be held. */
+void drop_newest(delivery_t delivery, unsigned int payload_size)
+{
+  delivery->dropped_payloads++;
+  delivery->dropped_bytes += payload_size;
+}
+
+void delivery_push(delivery_t delivery,
+                   delivery_callback callback,
+                   void *context,
+                   char *id,
+                   unsigned char *payload,
+                   unsigned int payload_size)
+{
+  struct payload_s *p = NULL;
+
+  if(payload_size <= delivery->max_bytes)
+  {
+    p = malloc(sizeof(struct payload_s) + payload_size);
+  }
+  pthread_mutex_lock(&delivery->mutex);
+  if(p == NULL)
+  {
+    /* Too large for the queue, or no memory */
+    drop_newest(delivery, payload_size);
+    pthread_mutex_unlock(&delivery->mutex);
+    return;
+  }
+  while(delivery->queued_bytes + payload_size > delivery->max_bytes)
+  {
+    if((delivery->policy == DELIVERY_DROP_NEWEST) ||
+       ((delivery->policy == DELIVERY_DROP_OLDEST) && (delivery->first == NULL)))
+    {
+      /* With DROP_OLDEST, the queue can only be full of the payload being
+       * written by the writer thread, which can't be removed */
+      drop_newest(delivery, payload_size);
+      pthread_mutex_unlock(&delivery->mutex);
+      free(p);
+      return;
+    }
+    else if(delivery->policy == DELIVERY_DROP_OLDEST)
+    {
+      drop_oldest(delivery);
+    }
+    else
+    {
+      pthread_cond_wait(&delivery->not_full, &delivery->mutex);
+    }
+  }
+
+  p->callback = callback;
+  p->context = context;
+  memcpy(p->id, id, 5);
+  p->size = payload_size;
+  p->next = NULL;
+  memcpy(p->data, payload, payload_size);
+  if(delivery->last)
+  {
+    delivery->last->next = p;
+  }
+  else
+  {
+    delivery->first = p;
+  }
+  delivery->last = p;
+  delivery->queued_bytes += payload_size;
+  pthread_cond_signal(&delivery->not_empty);
+  pthread_mutex_unlock(&delivery->mutex);
+}
+
+void delivery_get_counts(delivery_t delivery,
+                         unsigned long long int *queued_bytes,
+                         unsigned long long int *dropped_payloads,
+                         unsigned long long int *dropped_bytes)
+{
+  pthread_mutex_lock(&delivery->mutex);
+  *queued_bytes = delivery->queued_bytes;
+  *dropped_payloads = delivery->dropped_payloads;
+  *dropped_bytes = delivery->dropped_bytes;
+  pthread_mutex_unlock(&delivery->mutex);
+}
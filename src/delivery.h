@@ -0,0 +1,74 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DELIVERY_H
+#define DELIVERY_H
+
+/* What to do with a payload when the delivery queue is full */
+typedef enum
+  {
+    /* Wait until the writer thread has made some room */
+    DELIVERY_BLOCK,
+    /* Discard the oldest payloads of the queue */
+    DELIVERY_DROP_OLDEST,
+    /* Discard the new payload */
+    DELIVERY_DROP_NEWEST
+  } delivery_policy_t;
+
+/* Queue of received payloads passed to a callback by its own writer thread,
+ * so that a slow consumer doesn't stall the thread receiving the frames */
+typedef struct delivery_s *delivery_t;
+
+/* Function called by the writer thread for each payload */
+typedef int (*delivery_callback)(void *context,
+                                 char *id,
+                                 unsigned char *payload,
+                                 unsigned int payload_size);
+
+/* Create a queue holding at most 'max_bytes' bytes of payload, and start its
+ * writer thread. A payload larger than 'max_bytes' is always dropped.
+ * If the creation fails, the function returns NULL. */
+delivery_t delivery_create(unsigned int max_bytes, delivery_policy_t policy);
+
+/* Wait until all the queued payloads have been passed to their callbacks
+ * and stop the writer thread. No payload can be pushed afterwards. */
+void delivery_finish(delivery_t delivery);
+
+/* Destroy a queue, after delivery_finish() */
+void delivery_free(delivery_t delivery);
+
+/* Copy a payload to the queue, or drop it according to the policy of the
+ * queue. The writer thread will call
+ * 'callback(context, id, payload, payload_size)'. */
+void delivery_push(delivery_t delivery,
+                   delivery_callback callback,
+                   void *context,
+                   char *id,
+                   unsigned char *payload,
+                   unsigned int payload_size);
+
+/* Get the number of bytes waiting in the queue, and the numbers of payloads
+ * and bytes dropped because the queue was full */
+void delivery_get_counts(delivery_t delivery,
+                         unsigned long long int *queued_bytes,
+                         unsigned long long int *dropped_payloads,
+                         unsigned long long int *dropped_bytes);
+
+#endif
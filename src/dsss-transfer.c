@@ -19,21 +19,34 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <complex.h>
-#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
 #include <liquid/liquid.h>
 #include <math.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <SoapySDR/Device.h>
 #include <SoapySDR/Formats.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include "dsssframe.h"
+#include "delivery.h"
+#include "dump.h"
 #include "dsss-transfer.h"
 #include "gettext.h"
+#include "kernels.h"
+#include "loopback.h"
+#include "mapped-file.h"
+#include "recorder.h"
+#include "ring.h"
+#include "timing.h"
 
 #define TAU (2 * M_PI)
 
@@ -56,12 +69,14 @@ typedef enum
   {
     IO,
     FILENAME,
+    LOOPBACK,
     SOAPYSDR
   } radio_type_t;
 
 typedef union
 {
   FILE *file;
+  loopback_t loopback;
   SoapySDRDevice *soapysdr;
 } radio_device_t;
 
@@ -70,11 +85,41 @@ typedef union
   SoapySDRStream *soapysdr;
 } radio_stream_t;
 
+/* Destination and statistics of the frames of one transfer id */
+struct id_route_s
+{
+  dsss_transfer_id_callback callback;
+  void *context;
+  dsss_transfer_id_stats_t stats;
+  unsigned int last_counter;
+};
+
+/* Frame events triggering the recorder */
+#define RECORD_HEADER_ERRORS 1
+#define RECORD_PAYLOAD_ERRORS 2
+#define RECORD_VALID_FRAMES 4
+
+/* Largest payload that can be put in a frame */
+#define MAX_PAYLOAD_SIZE 65535
+
+/* Largest durations of the processing blocks and of the frames (ms) */
+#define MAX_BLOCK_DURATION 1000
+#define MAX_FRAME_DURATION 10000
+
+/* Maximum number of ids for which statistics are kept */
+#define MAX_ROUTES 256
+
+/* Number of IQ samples converted at once from or to audio samples */
+#define AUDIO_BLOCK_SIZE 1024
+
 struct dsss_transfer_s
 {
   radio_type_t radio_type;
   radio_device_t radio_device;
   radio_stream_t radio_stream;
+  /* Recording of IQ samples mapped in memory when the FILENAME radio is
+   * used to receive, or NULL */
+  mapped_file_t mapped_file;
   unsigned char emit;
   FILE *file;
   unsigned long int sample_rate;
@@ -87,51 +132,149 @@ struct dsss_transfer_s
   fec_scheme outer_fec;
   char id[5];
   FILE *dump;
-  unsigned char stop;
+  /* Format of the samples in the dump file, and writer thread of the dump
+   * while the transfer is running */
+  sample_format_t dump_format;
+  unsigned char dump_format_set;
+  dump_t dump_writer;
+  /* Files for the samples around the frame events selected by
+   * 'recorder_events' (NULL if not used), number of seconds of samples kept
+   * in memory, and recorder while the transfer is receiving */
+  char *recorder_filename;
+  float recorder_duration;
+  unsigned int recorder_events;
+  recorder_t recorder;
+  atomic_int stop;
+  /* Value of 'stop_generation' when the transfer was started */
+  unsigned int start_generation;
+  unsigned char verbose;
+  /* Whether 'verbose' was set by dsss_transfer_set_verbosity() instead of
+   * coming from 'default_verbose' */
+  unsigned char verbose_set;
   int (*data_callback)(void *, unsigned char *, unsigned int);
   void *callback_context;
   unsigned int timeout;
-  time_t timeout_start;
+  /* Time of the last frame, written by the thread synchronizing the frames
+   * and read by the radio thread in pipelined mode */
+  atomic_llong timeout_start;
   firhilbf audio_converter;
   float audio_gain;
+  /* Format of the audio samples: CS16 for 16 bit integers, CF32 for
+   * floats */
+  sample_format_t audio_format;
+  /* With the direct modem, the IQ samples are at the rate of the audio
+   * samples and are shifted to the carrier frequency, the audio samples
+   * being their real part */
+  unsigned char direct_audio;
+  unsigned long int audio_sample_rate;
+  unsigned long int audio_frequency;
+  unsigned int pipeline;
+  /* Duration of the processing blocks and approximate duration of the
+   * frames when the payload size is automatic (ms) */
+  unsigned int block_duration;
+  unsigned int frame_duration;
+  /* Maximal size of the payload of a frame (0 for automatic), time to wait
+   * for more data before sending a frame which is not full (ms), and
+   * time after which read_data() gives up waiting for data (ms) */
+  unsigned int payload_size;
+  unsigned int max_wait;
+  int input_timeout;
+  unsigned int decoding_threads;
+  sample_format_t sample_format;
+  unsigned int sample_size;
+  unsigned char fused_frontend;
+  float squelch;
+  unsigned int channels;
+  unsigned int *active_channels;
+  unsigned int active_channels_size;
+  struct id_route_s *routes;
+  unsigned int routes_size;
+  dsss_transfer_id_callback any_id_callback;
+  void *any_id_context;
+  pthread_mutex_t routes_mutex;
+  /* Incremented when a callback is added, to refresh the id filters */
+  atomic_uint routes_version;
+  timing_t timing;
+  /* Statistics, with the sums used to compute the means */
+  dsss_transfer_stats_t stats;
+  double evm_sum;
+  double rssi_sum;
+  double cfo_sum;
+  unsigned long long int measured_frames;
+  pthread_mutex_t stats_mutex;
+  /* Queue between the frame synchronizer and the callbacks, used while
+   * receiving if 'delivery_size' is not 0 */
+  unsigned int delivery_size;
+  delivery_policy_t delivery_policy;
+  delivery_t delivery;
 };
 
-unsigned char stop = 0;
-unsigned char verbose = 0;
+/* The transfers don't share any state, except these two variables.
+ * 'stop_generation' is incremented by dsss_transfer_stop_all() to stop all
+ * the transfers started before, without locks so that it can be done by
+ * a signal handler. 'default_verbose' is the verbosity level of the
+ * transfers without a level of their own, read again when they start. */
+atomic_uint stop_generation = 0;
+atomic_uchar default_verbose = 0;
 
 void dsss_transfer_set_verbose(unsigned char v)
 {
-  verbose = v;
+  atomic_store(&default_verbose, v);
 }
 
 unsigned char dsss_transfer_is_verbose()
 {
-  return(verbose);
+  return(atomic_load(&default_verbose));
 }
 
+/* Check whether the transfer has been stopped by dsss_transfer_stop() or
+ * dsss_transfer_stop_all() */
+int is_stopped(dsss_transfer_t transfer)
+{
+  return(atomic_load(&transfer->stop) ||
+         (atomic_load(&stop_generation) != transfer->start_generation));
+}
+
+/* Queue a copy of the samples for the dump writer. The samples are dropped
+ * if the writer is late, it never makes the radio wait. */
 void dump_samples(dsss_transfer_t transfer,
-                  complex float *samples,
+                  const void *samples,
                   unsigned int samples_size)
 {
-  fwrite(samples, sizeof(complex float), samples_size, transfer->dump);
+  dump_push(transfer->dump_writer, samples, samples_size);
 }
 
+/* Wait until some data is available, but at most for the duration of
+ * a processing block or until the deadline of the frame being
+ * filled, then read what is available.
+ * Return the number of bytes read (0 if there was no data in time), or -1
+ * at the end of the input. */
 int read_data(void *context,
               unsigned char *payload,
               unsigned int payload_size)
 {
   dsss_transfer_t transfer = (dsss_transfer_t) context;
-  int n;
+  struct pollfd input;
+  ssize_t n;
 
-  if(feof(transfer->file))
+  input.fd = fileno(transfer->file);
+  input.events = POLLIN;
+  input.revents = 0;
+  if(poll(&input, 1, transfer->input_timeout) <= 0)
   {
-    return(-1);
+    /* Timeout, or interrupted by a signal */
+    return(0);
   }
 
-  n = fread(payload, 1, payload_size, transfer->file);
+  n = read(input.fd, payload, payload_size);
+  if(n < 0)
+  {
+    return(((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1);
+  }
   if(n == 0)
   {
-    usleep(1);
+    /* End of file, or the writer closed the pipe */
+    return(-1);
   }
 
   return(n);
@@ -152,52 +295,113 @@ int write_data(void *context,
   return(payload_size);
 }
 
+/* Convert IQ samples to audio samples and write them, by blocks of
+ * AUDIO_BLOCK_SIZE IQ samples (2 audio samples per IQ sample) */
 void write_audio(dsss_transfer_t transfer,
                  complex float *samples,
                  unsigned int samples_size,
                  FILE *output)
 {
-  float gain = transfer->audio_gain;
+  unsigned int value_size = sample_format_size(transfer->audio_format) / 2;
+  float audio_samples[2 * AUDIO_BLOCK_SIZE];
+  unsigned char raw_samples[2 * AUDIO_BLOCK_SIZE * sizeof(float)];
+  unsigned int i;
   unsigned int n;
-  float audio_samples[2];
-  short int audio_samples_s16[2];
 
-  for(n = 0; n < samples_size; n++)
+  for(i = 0; i < samples_size; i += n)
   {
-    firhilbf_interp_execute(transfer->audio_converter,
-                            samples[n],
-                            audio_samples);
-    audio_samples_s16[0] = (audio_samples[0] * gain) * 32767;
-    audio_samples_s16[1] = (audio_samples[1] * gain) * 32767;
-    fwrite(audio_samples_s16, sizeof(short int), 2, output);
+    n = MIN(AUDIO_BLOCK_SIZE, samples_size - i);
+    firhilbf_interp_execute_block(transfer->audio_converter,
+                                  samples + i,
+                                  n,
+                                  audio_samples);
+    kernel_convert_from_float(audio_samples,
+                              raw_samples,
+                              2 * n,
+                              transfer->audio_format,
+                              transfer->audio_gain);
+    fwrite(raw_samples, value_size, 2 * n, output);
   }
 }
 
+/* Read audio samples and convert them to IQ samples, by blocks of
+ * AUDIO_BLOCK_SIZE IQ samples */
 unsigned int read_audio(dsss_transfer_t transfer,
                         complex float *samples,
                         unsigned int samples_size,
                         FILE* input)
 {
-  float gain = transfer->audio_gain;
-  unsigned int n = 0;
-  float audio_samples[2];
-  short int audio_samples_s16[2];
+  unsigned int value_size = sample_format_size(transfer->audio_format) / 2;
+  float audio_samples[2 * AUDIO_BLOCK_SIZE];
+  unsigned char raw_samples[2 * AUDIO_BLOCK_SIZE * sizeof(float)];
+  float *values;
+  unsigned int i;
+  unsigned int j;
+  unsigned int n;
 
-  while((n < samples_size) &&
-        (fread(audio_samples_s16, sizeof(short int), 2, input) == 2))
+  if(transfer->direct_audio)
   {
-    audio_samples[0] = (audio_samples_s16[0] * gain) / 32768.0;
-    audio_samples[1] = (audio_samples_s16[1] * gain) / 32768.0;
-    firhilbf_decim_execute(transfer->audio_converter,
-                           audio_samples,
-                           &samples[n]);
-    n++;
+    for(i = 0; i < samples_size; i += n)
+    {
+      n = MIN(AUDIO_BLOCK_SIZE, samples_size - i);
+      n = fread(raw_samples, value_size, n, input);
+      if(n == 0)
+      {
+        break;
+      }
+      /* The real values are put in the first half of the block, then
+       * spread from the end so that none is overwritten before being
+       * read. The image at minus the carrier frequency is removed by the
+       * low pass filter of the receiver, the factor 2 compensates for the
+       * amplitude lost with it. */
+      values = (float *) (samples + i);
+      kernel_convert_to_float(transfer->audio_format,
+                              raw_samples,
+                              values,
+                              n,
+                              2 * transfer->audio_gain);
+      for(j = n; j > 0; j--)
+      {
+        samples[i + j - 1] = values[j - 1];
+      }
+    }
+    return(i);
   }
-  return(n);
+
+  for(i = 0; i < samples_size; i += n)
+  {
+    n = MIN(AUDIO_BLOCK_SIZE, samples_size - i);
+    /* An incomplete pair of audio samples at the end is ignored */
+    n = fread(raw_samples, value_size, 2 * n, input) / 2;
+    if(n == 0)
+    {
+      break;
+    }
+    kernel_convert_to_float(transfer->audio_format,
+                            raw_samples,
+                            audio_samples,
+                            2 * n,
+                            transfer->audio_gain);
+    firhilbf_decim_execute_block(transfer->audio_converter,
+                                 audio_samples,
+                                 n,
+                                 samples + i);
+  }
+  return(i);
+}
+
+/* Add 'value' to a counter of the statistics */
+void count_stat(dsss_transfer_t transfer,
+                unsigned long long int *counter,
+                unsigned long long int value)
+{
+  pthread_mutex_lock(&transfer->stats_mutex);
+  *counter += value;
+  pthread_mutex_unlock(&transfer->stats_mutex);
 }
 
 void send_to_radio(dsss_transfer_t transfer,
-                   complex float *samples,
+                   void *samples,
                    unsigned int samples_size,
                    int last)
 {
@@ -209,7 +413,7 @@ void send_to_radio(dsss_transfer_t transfer,
   int r;
   const void *buffers[1];
 
-  if(transfer->dump)
+  if(transfer->dump_writer)
   {
     dump_samples(transfer, samples, samples_size);
   }
@@ -223,7 +427,7 @@ void send_to_radio(dsss_transfer_t transfer,
     }
     else
     {
-      fwrite(samples, sizeof(complex float), samples_size, stdout);
+      fwrite(samples, transfer->sample_size, samples_size, stdout);
     }
     break;
 
@@ -235,17 +439,28 @@ void send_to_radio(dsss_transfer_t transfer,
     else
     {
       fwrite(samples,
-             sizeof(complex float),
+             transfer->sample_size,
              samples_size,
              transfer->radio_device.file);
     }
     break;
 
+  case LOOPBACK:
+    loopback_write(transfer->radio_device.loopback,
+                   samples,
+                   samples_size * transfer->sample_size);
+    if(last)
+    {
+      /* End of the stream for the receiver */
+      loopback_close(transfer->radio_device.loopback);
+    }
+    break;
+
   case SOAPYSDR:
     n = 0;
-    while((n < samples_size) && (!stop) && (!transfer->stop))
+    while((n < samples_size) && !is_stopped(transfer))
     {
-      buffers[0] = &samples[n];
+      buffers[0] = (unsigned char *) samples + n * transfer->sample_size;
       size = samples_size - n;
       r = SoapySDRDevice_writeStream(transfer->radio_device.soapysdr,
                                      transfer->radio_stream.soapysdr,
@@ -262,6 +477,10 @@ void send_to_radio(dsss_transfer_t transfer,
       {
          // Just continue to check stop flag
       }
+      else if(r == SOAPY_SDR_UNDERFLOW)
+      {
+        count_stat(transfer, &transfer->stats.underflows, 1);
+      }
       else
       {
           // Other errors
@@ -276,9 +495,9 @@ void send_to_radio(dsss_transfer_t transfer,
       flags = SOAPY_SDR_END_BURST;
       size = SoapySDRDevice_getStreamMTU(transfer->radio_device.soapysdr,
                                          transfer->radio_stream.soapysdr);
-      bzero(samples, samples_size * sizeof(complex float));
+      bzero(samples, samples_size * transfer->sample_size);
       buffers[0] = samples;
-      while((size > 0) && (!stop) && (!transfer->stop))
+      while((size > 0) && !is_stopped(transfer))
       {
         n = (samples_size < size) ? samples_size : size;
         r = SoapySDRDevice_writeStream(transfer->radio_device.soapysdr,
@@ -306,17 +525,30 @@ void send_to_radio(dsss_transfer_t transfer,
                                             &timestamp,
                                             10000);
       }
-      while((r != SOAPY_SDR_UNDERFLOW) && (!stop) && (!transfer->stop));
+      while((r != SOAPY_SDR_UNDERFLOW) && !is_stopped(transfer));
     }
     break;
   }
 }
 
+/* Get the address of at most 'samples_size' samples of the recording mapped
+ * in memory. Return the number of samples. */
+unsigned int map_samples(dsss_transfer_t transfer,
+                         const void **samples,
+                         unsigned int samples_size)
+{
+  size_t size = (size_t) samples_size * transfer->sample_size;
+
+  *samples = mapped_file_read(transfer->mapped_file, &size);
+  return(size / transfer->sample_size);
+}
+
 unsigned int receive_from_radio(dsss_transfer_t transfer,
-                                complex float *samples,
+                                void *samples,
                                 unsigned int samples_size)
 {
   unsigned int n = 0;
+  const void *data;
   int flags;
   long long int timestamp;
   int r;
@@ -331,7 +563,7 @@ unsigned int receive_from_radio(dsss_transfer_t transfer,
     }
     else
     {
-      n = fread(samples, sizeof(complex float), samples_size, stdin);
+      n = fread(samples, transfer->sample_size, samples_size, stdin);
     }
     break;
 
@@ -343,15 +575,28 @@ unsigned int receive_from_radio(dsss_transfer_t transfer,
                      samples_size,
                      transfer->radio_device.file);
     }
+    else if(transfer->mapped_file)
+    {
+      /* For the callers needing the samples in their buffer */
+      n = map_samples(transfer, &data, samples_size);
+      memcpy(samples, data, n * transfer->sample_size);
+    }
     else
     {
       n = fread(samples,
-                sizeof(complex float),
+                transfer->sample_size,
                 samples_size,
                 transfer->radio_device.file);
     }
     break;
 
+  case LOOPBACK:
+    n = loopback_read(transfer->radio_device.loopback,
+                      samples,
+                      samples_size * transfer->sample_size);
+    n /= transfer->sample_size;
+    break;
+
   case SOAPYSDR:
     buffers[0] = samples;
     r = SoapySDRDevice_readStream(transfer->radio_device.soapysdr,
@@ -365,6 +610,10 @@ unsigned int receive_from_radio(dsss_transfer_t transfer,
     {
       n = r;
     }
+    else if(r == SOAPY_SDR_OVERFLOW)
+    {
+      count_stat(transfer, &transfer->stats.overflows, 1);
+    }
     break;
   }
   return(n);
@@ -383,745 +632,3775 @@ unsigned int get_counter(unsigned char *header)
   return((header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7]);
 }
 
-void send_dummy_samples(dsss_transfer_t transfer,
-                        msresamp_crcf resampler,
-                        nco_crcf oscillator,
-                        complex float *samples,
-                        unsigned int delay,
-                        int last)
+void print_queue_depth(const char *name, ring_t queue)
 {
-  unsigned int i;
-  unsigned int n;
-  complex float zero_sample = 0;
+  float mean;
+  unsigned int maximum;
 
-  for(i = 0; i < delay; i++)
-  {
-    msresamp_crcf_execute(resampler, &zero_sample, 1, samples, &n);
-    if(transfer->frequency_offset != 0)
-    {
-      nco_crcf_mix_block_up(oscillator, samples, samples, n);
-    }
-    if(i + 1 < delay)
-    {
-      send_to_radio(transfer, samples, n, 0);
-    }
-    else
-    {
-      send_to_radio(transfer, samples, n, last);
-    }
-  }
+  ring_get_depth(queue, &mean, &maximum);
+  fprintf(stderr,
+          _("Info: %s queue depth: mean %.1f, max %u of %u blocks\n"),
+          name,
+          mean,
+          maximum,
+          ring_get_slots(queue));
 }
 
-void send_frames(dsss_transfer_t transfer)
+struct transmitter_s
+{
+  dsss_transfer_t transfer;
+  dsssframegen frame_generator;
+  float gain;
+  unsigned char header[8];
+  unsigned int counter;
+  msresamp_crcf resampler;
+  unsigned int delay;
+  nco_crcf oscillator;
+  mixer_t mixer;
+  unsigned int frame_samples_size;
+  complex float *frame_samples;
+  unsigned int samples_size;
+  complex float *samples;
+  void *radio_samples;
+  /* Pipelined mode: the payloads read in advance, and the samples waiting
+   * for the radio thread */
+  ring_t payload_queue;
+  ring_t radio_queue;
+  /* Set while the samples of a frame are being produced, to tell the
+   * underflows in the middle of a frame from the idle periods */
+  atomic_int in_frame;
+};
+
+/* Flag in the size of the last block of samples of the radio queue */
+#define LAST_BLOCK 0x80000000
+
+void transmitter_init(struct transmitter_s *transmitter,
+                      dsss_transfer_t transfer)
 {
   unsigned int samples_per_symbol = 2;
   float samples_per_bit = transfer->spreading_factor * samples_per_symbol;
-  dsssframegenprops_s frame_properties;
-  dsssframegen frame_generator;
   float resampling_ratio = (float) transfer->sample_rate / (transfer->bit_rate *
                                                             samples_per_bit);
-  msresamp_crcf resampler = msresamp_crcf_create(resampling_ratio, 60);
-  unsigned int delay = ceilf(msresamp_crcf_get_delay(resampler));
-  unsigned int header_size = 8;
-  unsigned char header[header_size];
-  /* Try to make frames of approximately 100 ms, but containing at least
-   * 16 bytes and at most 8000 bytes of payload */
-  unsigned int byte_rate = transfer->bit_rate / 8;
-  unsigned int payload_size = MIN(MAX(byte_rate * 0.1, 16), 8000);
-  int r;
-  unsigned int n;
-  unsigned int i;
-  /* Process data by blocks of 50 ms */
-  unsigned int frame_samples_size = ceilf((transfer->bit_rate *
-                                           samples_per_bit) / 20.0);
-  unsigned int samples_size = ceilf((frame_samples_size + delay) * resampling_ratio);
-  int frame_complete;
   float center_frequency = (float) transfer->frequency_offset / transfer->sample_rate;
-  nco_crcf oscillator = nco_crcf_create(LIQUID_NCO);
-  float maximum_amplitude = 1;
-  unsigned int counter = 0;
-  unsigned char *payload = malloc(payload_size);
-  complex float *frame_samples = malloc(frame_samples_size * sizeof(complex float));
-  complex float *samples = malloc(samples_size * sizeof(complex float));
+  dsssframegenprops_s frame_properties;
+
+  transmitter->transfer = transfer;
+  frame_properties.check = transfer->crc;
+  frame_properties.fec0 = transfer->inner_fec;
+  frame_properties.fec1 = transfer->outer_fec;
+  transmitter->frame_generator = dsssframegen_create_set(transfer->spreading_factor,
+                                                         &frame_properties);
+  dsssframegen_set_header_props(transmitter->frame_generator, &frame_properties);
+  dsssframegen_set_header_len(transmitter->frame_generator,
+                              sizeof(transmitter->header));
+  /* Reduce the amplitude of samples because the frame generator may
+   * produce samples with an amplitude greater than 1.0. The gain is the
+   * same for all the frames, so that the samples don't have to be searched
+   * for their peak before being scaled. */
+  transmitter->gain = 0.75 / MAX(1,
+                                 dsssframegen_get_max_amplitude(transmitter->frame_generator));
+  transmitter->counter = 0;
+  memcpy(transmitter->header, transfer->id, 4);
+  set_counter(transmitter->header, transmitter->counter);
 
-  if((payload == NULL) || (frame_samples == NULL) || (samples == NULL))
+  transmitter->resampler = msresamp_crcf_create(resampling_ratio, 60);
+  transmitter->delay = ceilf(msresamp_crcf_get_delay(transmitter->resampler));
+  /* Process data by blocks of 'block_duration' (50 ms by default) */
+  transmitter->frame_samples_size = ceilf((transfer->bit_rate *
+                                           samples_per_bit *
+                                           transfer->block_duration) / 1000.0);
+  transmitter->samples_size = ceilf((transmitter->frame_samples_size +
+                                     transmitter->delay) * resampling_ratio);
+
+  transmitter->oscillator = nco_crcf_create(LIQUID_NCO);
+  nco_crcf_set_phase(transmitter->oscillator, 0);
+  nco_crcf_set_frequency(transmitter->oscillator, TAU * center_frequency);
+  mixer_init(&transmitter->mixer, TAU * center_frequency);
+
+  transmitter->payload_queue = NULL;
+  transmitter->radio_queue = NULL;
+  atomic_init(&transmitter->in_frame, 0);
+
+  transmitter->frame_samples = malloc(MAX(transmitter->frame_samples_size,
+                                          transmitter->delay) *
+                                      sizeof(complex float));
+  transmitter->samples = malloc(transmitter->samples_size *
+                                sizeof(complex float));
+  if(transfer->sample_format == SAMPLE_FORMAT_CF32)
+  {
+    transmitter->radio_samples = transmitter->samples;
+  }
+  else
+  {
+    transmitter->radio_samples = malloc(transmitter->samples_size *
+                                        transfer->sample_size);
+  }
+  if((transmitter->frame_samples == NULL) ||
+     (transmitter->samples == NULL) ||
+     (transmitter->radio_samples == NULL))
   {
     fprintf(stderr, _("Error: Memory allocation failed\n"));
     exit(EXIT_FAILURE);
   }
+}
 
-  nco_crcf_set_phase(oscillator, 0);
-  nco_crcf_set_frequency(oscillator, TAU * center_frequency);
+void transmitter_free(struct transmitter_s *transmitter)
+{
+  if(transmitter->radio_samples != transmitter->samples)
+  {
+    free(transmitter->radio_samples);
+  }
+  free(transmitter->samples);
+  free(transmitter->frame_samples);
+  nco_crcf_destroy(transmitter->oscillator);
+  msresamp_crcf_destroy(transmitter->resampler);
+  dsssframegen_destroy(transmitter->frame_generator);
+  ring_free(transmitter->payload_queue);
+  ring_free(transmitter->radio_queue);
+}
 
-  frame_properties.check = transfer->crc;
-  frame_properties.fec0 = transfer->inner_fec;
-  frame_properties.fec1 = transfer->outer_fec;
-  frame_generator = dsssframegen_create_set(transfer->spreading_factor,
-                                            &frame_properties);
-  dsssframegen_set_header_props(frame_generator, &frame_properties);
-  dsssframegen_set_header_len(frame_generator, header_size);
-  memcpy(header, transfer->id, 4);
-  set_counter(header, counter);
+/* Shift the resampled signal to the frequency of the transfer, convert it
+ * to the format of the radio and send it, or give it to the radio thread
+ * in pipelined mode */
+void transmit_samples(struct transmitter_s *transmitter,
+                      unsigned int samples_size,
+                      int last)
+{
+  dsss_transfer_t transfer = transmitter->transfer;
+  void *block;
+  TIMING_START(start);
 
-  while((!stop) && (!transfer->stop))
+  if(transfer->sample_format != SAMPLE_FORMAT_CF32)
   {
-    r = transfer->data_callback(transfer->callback_context, payload, payload_size);
-    if(r < 0)
+    /* Frequency shift and conversion in one pass */
+    kernel_mix_up_convert(transmitter->samples,
+                          transmitter->radio_samples,
+                          samples_size,
+                          transfer->sample_format,
+                          (transfer->frequency_offset != 0) ?
+                          &transmitter->mixer :
+                          NULL);
+  }
+  else if(transfer->frequency_offset != 0)
+  {
+    nco_crcf_mix_block_up(transmitter->oscillator,
+                          transmitter->samples,
+                          transmitter->samples,
+                          samples_size);
+  }
+  TIMING_STOP(transfer->timing, TIMING_FRONTEND, start);
+  TIMING_SIGNAL(transfer->timing, samples_size, transfer->sample_rate);
+
+  if(transmitter->radio_queue)
+  {
+    block = ring_write_begin(transmitter->radio_queue);
+    if(block)
     {
-      break;
+      memcpy(block,
+             transmitter->radio_samples,
+             samples_size * transfer->sample_size);
+      ring_write_end(transmitter->radio_queue,
+                     (samples_size * transfer->sample_size) |
+                     (last ? LAST_BLOCK : 0));
     }
-    n = r;
-    if(n > 0)
+    return;
+  }
+
+  TIMING_START(radio_start);
+  send_to_radio(transfer, transmitter->radio_samples, samples_size, last);
+  TIMING_STOP(transfer->timing, TIMING_RADIO, radio_start);
+  count_stat(transfer, &transfer->stats.samples, samples_size);
+}
+
+/* Send some dummy samples to get the remaining output samples (because of
+ * resampler and filter delays) and send them */
+void send_dummy_samples(struct transmitter_s *transmitter, int last)
+{
+  unsigned int i;
+  unsigned int n;
+
+  for(i = 0; i < transmitter->delay; i++)
+  {
+    transmitter->frame_samples[i] = 0;
+  }
+  msresamp_crcf_execute(transmitter->resampler,
+                        transmitter->frame_samples,
+                        transmitter->delay,
+                        transmitter->samples,
+                        &n);
+  transmit_samples(transmitter, n, last);
+}
+
+/* Modulate a frame and send its samples */
+void send_frame(struct transmitter_s *transmitter,
+                unsigned char *payload,
+                unsigned int payload_size)
+{
+  dsss_transfer_t transfer = transmitter->transfer;
+  complex float *frame_samples = transmitter->frame_samples;
+  unsigned int frame_samples_size = transmitter->frame_samples_size;
+  int frame_complete = 0;
+  unsigned int n;
+
+  atomic_store(&transmitter->in_frame, 1);
+  dsssframegen_assemble(transmitter->frame_generator,
+                        transmitter->header,
+                        payload,
+                        payload_size);
+  while(!frame_complete)
+  {
+    TIMING_START(framing_start);
+    frame_complete = dsssframegen_write_samples(transmitter->frame_generator,
+                                                frame_samples,
+                                                frame_samples_size);
+    n = frame_samples_size;
+    if(frame_complete)
     {
-      dsssframegen_assemble(frame_generator, header, payload, n);
-      frame_complete = 0;
-      while(!frame_complete)
+      /* Don't send the padding 0 bytes */
+      while((n > 0) && (frame_samples[n - 1] == 0))
       {
-        frame_complete = dsssframegen_write_samples(frame_generator,
-                                                    frame_samples,
-                                                    frame_samples_size);
-        n = frame_samples_size;
-        if(frame_complete)
-        {
-          /* Don't send the padding 0 bytes */
-          while((n > 0) && (frame_samples[n - 1] == 0))
-          {
-            n--;
-          }
-        }
-        /* Reduce the amplitude of samples because the frame generator and
-         * the resampler may produce samples with an amplitude greater than
-         * 1.0 depending on the number of carriers and resampling ratio */
-        maximum_amplitude = 1;
-        for(i = 0; i < n; i++)
-        {
-          if(cabsf(frame_samples[i]) > maximum_amplitude)
-          {
-            maximum_amplitude = cabsf(frame_samples[i]);
-          }
-        }
-        liquid_vectorcf_mulscalar(frame_samples,
-                                  n,
-                                  0.75 / maximum_amplitude,
-                                  frame_samples);
-        msresamp_crcf_execute(resampler, frame_samples, n, samples, &n);
-        if(transfer->frequency_offset != 0)
-        {
-          nco_crcf_mix_block_up(oscillator, samples, samples, n);
-        }
-        send_to_radio(transfer, samples, n, 0);
+        n--;
       }
-      counter++;
-      set_counter(header, counter);
-    }
-    else
-    {
-      /* Underrun when reading from stdin. Send some dummy samples to get the
-       * remaining output samples for the end of current frame (because of
-       * resampler and filter delays) and send them */
-      send_dummy_samples(transfer,
-                         resampler,
-                         oscillator,
-                         samples,
-                         delay,
-                         0);
     }
+    kernel_scale(frame_samples, frame_samples, n, transmitter->gain);
+    TIMING_STOP(transfer->timing, TIMING_FRAMING, framing_start);
+    TIMING_START(frontend_start);
+    msresamp_crcf_execute(transmitter->resampler,
+                          frame_samples,
+                          n,
+                          transmitter->samples,
+                          &n);
+    TIMING_STOP(transfer->timing, TIMING_FRONTEND, frontend_start);
+    transmit_samples(transmitter, n, 0);
   }
+  atomic_store(&transmitter->in_frame, 0);
 
-  /* Send some dummy samples to get the remaining output samples (because of
-   * resampler and filter delays) */
-  send_dummy_samples(transfer,
-                     resampler,
-                     oscillator,
-                     samples,
-                     delay,
-                     1);
-
-  free(samples);
-  free(frame_samples);
-  free(payload);
-  nco_crcf_destroy(oscillator);
-  msresamp_crcf_destroy(resampler);
-  dsssframegen_destroy(frame_generator);
+  transmitter->counter++;
+  set_counter(transmitter->header, transmitter->counter);
+  pthread_mutex_lock(&transfer->stats_mutex);
+  transfer->stats.frames++;
+  transfer->stats.bytes += payload_size;
+  pthread_mutex_unlock(&transfer->stats_mutex);
 }
 
-int frame_received(unsigned char *header,
-                   int header_valid,
-                   unsigned char *payload,
-                   unsigned int payload_size,
-                   int payload_valid,
-                   framesyncstats_s stats,
-                   void *user_data)
+/* Get a payload from the data callback.
+ * Return its size, or -1 if the input stream is finished. */
+int read_payload(dsss_transfer_t transfer,
+                 unsigned char *payload,
+                 unsigned int payload_size)
 {
-  dsss_transfer_t transfer = (dsss_transfer_t) user_data;
-  char id[5];
-  unsigned int counter;
+  int r;
+  TIMING_START(start);
 
-  transfer->timeout_start = time(NULL);
-  memcpy(id, header, 4);
-  id[4] = '\0';
-  counter = get_counter(header);
+  r = transfer->data_callback(transfer->callback_context, payload, payload_size);
+  TIMING_STOP(transfer->timing, TIMING_CALLBACK, start);
+
+  return(r);
+}
+
+/* Get a payload of at most 'payload_size' bytes from the data callback.
+ * If 'max_wait' is not 0, call it again until the payload is full or until
+ * 'max_wait' ms have passed since the first bytes were read, so that small
+ * writes share the preamble, header and CRC of a frame.
+ * Return the size of the payload (0 if there was no data in time), and set
+ * 'end' to 1 when the input stream is finished. */
+int coalesce_payload(dsss_transfer_t transfer,
+                     unsigned char *payload,
+                     unsigned int payload_size,
+                     int *end)
+{
+  unsigned int size = 0;
+  double deadline = 0;
+  double remaining;
+  int r;
 
-  if(!header_valid || !payload_valid)
+  while(size < payload_size)
   {
-    if(verbose)
+    if(size > 0)
     {
-      if(!header_valid)
-      {
-        fprintf(stderr, _("Frame %u for '%s': corrupted header\n"), counter, id);
-      }
-      if(!payload_valid)
+      remaining = deadline - timing_now();
+      if((remaining <= 0) || is_stopped(transfer))
       {
-        fprintf(stderr, _("Frame %u for '%s': corrupted payload\n"), counter, id);
+        break;
       }
-      fflush(stderr);
+      /* Don't let read_data() wait after the deadline */
+      transfer->input_timeout = MIN(transfer->block_duration,
+                                    ceil(remaining * 1000));
     }
-  }
-  else if(memcmp(id, transfer->id, 4) != 0)
-  {
-    if(verbose)
+    r = read_payload(transfer, payload + size, payload_size - size);
+    transfer->input_timeout = transfer->block_duration;
+    if(r < 0)
     {
-      fprintf(stderr, _("Frame %u for '%s': ignored\n"), counter, id);
-      fflush(stderr);
+      *end = 1;
+      break;
+    }
+    size += r;
+    if((transfer->max_wait == 0) || (size == 0))
+    {
+      break;
+    }
+    if(deadline == 0)
+    {
+      deadline = timing_now() + transfer->max_wait / 1000.0;
+    }
+    if((r == 0) && (transfer->data_callback != read_data))
+    {
+      /* The callback doesn't wait for data, don't call it in a busy loop */
+      usleep(1000);
     }
   }
-  else
+
+  return(size);
+}
+
+/* Unless a size was set with dsss_transfer_set_coalescing(), try to make
+ * frames of approximately 'frame_duration' (100 ms by default), but
+ * containing at least 16 bytes and at most 8000 bytes of payload */
+unsigned int get_payload_size(dsss_transfer_t transfer)
+{
+  unsigned int byte_rate = transfer->bit_rate / 8;
+
+  if(transfer->payload_size > 0)
   {
-    transfer->data_callback(transfer->callback_context, payload, payload_size);
+    return(transfer->payload_size);
   }
-  return(0);
+
+  return(MIN(MAX(byte_rate * transfer->frame_duration / 1000.0, 16), 8000));
 }
 
-void receive_frames(dsss_transfer_t transfer)
+/* Upper bound of the number of radio samples used by a received frame. The
+ * payload size chosen by the transmitter is unknown, unless the largest one
+ * was given with dsss_transfer_set_coalescing(). The frame duration of the
+ * receiver is not used: the transmitter may use another one, up to
+ * MAX_FRAME_DURATION, and its automatic payloads are then at most 8000
+ * bytes, less than MAX_PAYLOAD_SIZE. */
+unsigned long int get_max_frame_samples(dsss_transfer_t transfer)
 {
-  unsigned int samples_per_symbol = 2;
-  float samples_per_bit = transfer->spreading_factor * samples_per_symbol;
-  dsssframegenprops_s frame_properties;
-  dsssframesync frame_synchronizer;
-  float resampling_ratio = (transfer->bit_rate *
-                            samples_per_bit) / (float) transfer->sample_rate;
-  msresamp_crcf resampler = msresamp_crcf_create(resampling_ratio, 60);
-  unsigned int delay = ceilf(msresamp_crcf_get_delay(resampler));
-  unsigned int header_size = 8;
-  unsigned int n;
-  /* Process data by blocks of 50 ms */
-  unsigned int frame_samples_size = ceilf((transfer->bit_rate *
-                                           samples_per_bit) / 20.0);
-  unsigned int samples_size = floorf(frame_samples_size / resampling_ratio);
-  nco_crcf oscillator = nco_crcf_create(LIQUID_NCO);
-  complex float *frame_samples = malloc((frame_samples_size + delay) *
-                                        sizeof(complex float));
-  complex float *samples = malloc((samples_size + delay) *
-                                  sizeof(complex float));
+  unsigned int header_size = 8 + 5 + crc_get_length(transfer->crc);
+  unsigned int payload_size = ((transfer->payload_size > 0) ?
+                               transfer->payload_size :
+                               MAX_PAYLOAD_SIZE) +
+    crc_get_length(transfer->crc);
+  unsigned int bits = 64;
 
-  if((frame_samples == NULL) || (samples == NULL))
+  /* The order in which the codes are applied changes the rounding, take
+   * the longest possibility */
+  bits += 8 * MAX(fec_get_enc_msg_length(transfer->outer_fec,
+                                         fec_get_enc_msg_length(transfer->inner_fec,
+                                                                header_size)),
+                  fec_get_enc_msg_length(transfer->inner_fec,
+                                         fec_get_enc_msg_length(transfer->outer_fec,
+                                                                header_size)));
+  bits += 8 * MAX(fec_get_enc_msg_length(transfer->outer_fec,
+                                         fec_get_enc_msg_length(transfer->inner_fec,
+                                                                payload_size)),
+                  fec_get_enc_msg_length(transfer->inner_fec,
+                                         fec_get_enc_msg_length(transfer->outer_fec,
+                                                                payload_size)));
+  return(ceilf(((float) bits / transfer->bit_rate) * transfer->sample_rate));
+}
+
+/* Read the payloads in advance */
+void * transmit_read_stage(void *arg)
+{
+  struct transmitter_s *transmitter = (struct transmitter_s *) arg;
+  dsss_transfer_t transfer = transmitter->transfer;
+  unsigned int payload_size = get_payload_size(transfer);
+  unsigned char *payload;
+  int r;
+  int end = 0;
+
+  while(!end && !is_stopped(transfer))
   {
-    fprintf(stderr, _("Error: Memory allocation failed\n"));
-    exit(EXIT_FAILURE);
+    payload = ring_write_begin(transmitter->payload_queue);
+    if(payload == NULL)
+    {
+      break;
+    }
+    r = coalesce_payload(transfer, payload, payload_size, &end);
+    if(r > 0)
+    {
+      ring_write_end(transmitter->payload_queue, r);
+    }
   }
+  ring_close(transmitter->payload_queue);
 
-  nco_crcf_set_phase(oscillator, 0);
-  nco_crcf_set_frequency(oscillator, TAU * ((float) transfer->frequency_offset /
-                                            transfer->sample_rate));
+  return(NULL);
+}
 
-  frame_synchronizer = dsssframesync_create_set(transfer->spreading_factor,
-                                                frame_received,
-                                                transfer);
-  frame_properties.check = transfer->crc;
-  frame_properties.fec0 = transfer->inner_fec;
-  frame_properties.fec1 = transfer->outer_fec;
-  dsssframesync_set_header_props(frame_synchronizer, &frame_properties);
-  dsssframesync_set_header_len(frame_synchronizer, header_size);
+/* Modulate the payloads and give the samples to the radio thread */
+void * transmit_modulation_stage(void *arg)
+{
+  struct transmitter_s *transmitter = (struct transmitter_s *) arg;
+  unsigned char *payload;
+  unsigned int size;
+  int flushed = 1;
 
-  while((!stop) && (!transfer->stop))
+  while(!is_stopped(transmitter->transfer))
   {
-    n = receive_from_radio(transfer, samples, samples_size);
-    if((n == 0) &&
-       ((transfer->radio_type == IO) || (transfer->radio_type == FILENAME)))
+    if(!flushed && !ring_readable(transmitter->payload_queue))
     {
-      break;
+      /* No data for now, send the end of the current frame */
+      send_dummy_samples(transmitter, 0);
+      flushed = 1;
     }
-    if((transfer->timeout > 0) &&
-       (time(NULL) > transfer->timeout_start + transfer->timeout))
+    payload = ring_read_begin(transmitter->payload_queue, &size);
+    if(payload == NULL)
     {
-      if(verbose)
-      {
-        fprintf(stderr, _("Timeout: %d s without frames\n"), transfer->timeout);
-      }
       break;
     }
-    if(transfer->dump)
+    send_frame(transmitter, payload, size);
+    ring_read_end(transmitter->payload_queue);
+    flushed = 0;
+  }
+  send_dummy_samples(transmitter, 1);
+  /* In case the radio thread is gone, stop the read thread too */
+  ring_close(transmitter->payload_queue);
+  ring_close(transmitter->radio_queue);
+
+  return(NULL);
+}
+
+/* Free the queues of a transmit pipeline that could not be started, so that
+ * the transmitter can work without them */
+void free_transmit_queues(struct transmitter_s *transmitter)
+{
+  ring_free(transmitter->payload_queue);
+  ring_free(transmitter->radio_queue);
+  transmitter->payload_queue = NULL;
+  transmitter->radio_queue = NULL;
+}
+
+/* Transmit using one thread for reading the data, one thread for the
+ * modulation, and the current thread for the radio.
+ * Return 0 if the pipeline could not be started, before any data has been
+ * read. */
+int send_frames_pipelined(struct transmitter_s *transmitter)
+{
+  dsss_transfer_t transfer = transmitter->transfer;
+  /* One slot per processing block */
+  unsigned int slots = MAX(2,
+                           (transfer->pipeline + transfer->block_duration - 1) /
+                           transfer->block_duration);
+  pthread_t read_thread;
+  pthread_t modulation_thread;
+  void *samples;
+  unsigned int size;
+  int last = 0;
+
+  /* One slot per frame */
+  transmitter->payload_queue = ring_create(MAX(2,
+                                               (transfer->pipeline +
+                                                transfer->frame_duration - 1) /
+                                               transfer->frame_duration),
+                                           get_payload_size(transfer));
+  transmitter->radio_queue = ring_create(slots,
+                                         transmitter->samples_size *
+                                         transfer->sample_size);
+  if((transmitter->payload_queue == NULL) ||
+     (transmitter->radio_queue == NULL))
+  {
+    free_transmit_queues(transmitter);
+    return(0);
+  }
+  /* The modulation thread is started first, as it doesn't read any data
+   * before the read thread runs */
+  if(pthread_create(&modulation_thread,
+                    NULL,
+                    transmit_modulation_stage,
+                    transmitter) != 0)
+  {
+    free_transmit_queues(transmitter);
+    return(0);
+  }
+  if(pthread_create(&read_thread, NULL, transmit_read_stage, transmitter) != 0)
+  {
+    /* The modulation thread only produces silence, which is dropped */
+    ring_close(transmitter->payload_queue);
+    ring_close(transmitter->radio_queue);
+    pthread_join(modulation_thread, NULL);
+    free_transmit_queues(transmitter);
+    return(0);
+  }
+
+  while(!last && !is_stopped(transfer))
+  {
+    if(!ring_readable(transmitter->radio_queue) &&
+       atomic_load(&transmitter->in_frame))
     {
-      dump_samples(transfer, samples, n);
+      /* The modulation is late, the radio will run out of samples in the
+       * middle of a frame */
+      count_stat(transfer, &transfer->stats.underflows, 1);
     }
-    if(transfer->frequency_offset != 0)
+    samples = ring_read_begin(transmitter->radio_queue, &size);
+    if(samples == NULL)
     {
-      nco_crcf_mix_block_down(oscillator, samples, samples, n);
+      break;
     }
-    msresamp_crcf_execute(resampler, samples, n, frame_samples, &n);
-    dsssframesync_execute(frame_synchronizer, frame_samples, n);
+    last = (size & LAST_BLOCK) != 0;
+    size = (size & ~LAST_BLOCK) / transfer->sample_size;
+    TIMING_START(start);
+    send_to_radio(transfer, samples, size, last);
+    TIMING_STOP(transfer->timing, TIMING_RADIO, start);
+    count_stat(transfer, &transfer->stats.samples, size);
+    ring_read_end(transmitter->radio_queue);
   }
-
-  for(n = 0; n < delay; n++)
+  ring_close(transmitter->radio_queue);
+  if(!last)
   {
-    samples[n] = 0;
+    /* Stopped before the end, still close the stream */
+    send_to_radio(transfer, transmitter->radio_samples, 0, 1);
   }
-  msresamp_crcf_execute(resampler, samples, delay, frame_samples, &n);
-  dsssframesync_execute(frame_synchronizer, frame_samples, n);
-  while(dsssframesync_is_frame_open(frame_synchronizer))
+
+  pthread_join(modulation_thread, NULL);
+  pthread_join(read_thread, NULL);
+  if(transfer->verbose)
   {
-    dsssframesync_execute(frame_synchronizer, samples, 1);
+    print_queue_depth(_("Payload"), transmitter->payload_queue);
+    print_queue_depth(_("Radio"), transmitter->radio_queue);
   }
 
-  free(samples);
-  free(frame_samples);
-  nco_crcf_destroy(oscillator);
-  msresamp_crcf_destroy(resampler);
-  dsssframesync_destroy(frame_synchronizer);
+  return(1);
 }
 
-dsss_transfer_t dsss_transfer_create_callback(char *radio_driver,
-                                              unsigned char emit,
-                                              int (*data_callback)(void *,
-                                                                   unsigned char *,
-                                                                   unsigned int),
-                                              void *callback_context,
-                                              unsigned long int sample_rate,
-                                              unsigned int bit_rate,
-                                              unsigned long int frequency,
-                                              long int frequency_offset,
-                                              char *gain,
-                                              float ppm,
-                                              unsigned int spreading_factor,
-                                              char *inner_fec,
-                                              char *outer_fec,
-                                              char *id,
-                                              char *dump,
-                                              unsigned int timeout,
-                                              unsigned char audio)
+void send_frames(dsss_transfer_t transfer)
 {
-  int direction;
-  SoapySDRKwargs kwargs;
-  unsigned int n;
-  char *gain_name;
-  int gain_value;
-  dsss_transfer_t transfer = malloc(sizeof(struct dsss_transfer_s));
+  struct transmitter_s transmitter;
+  unsigned int payload_size = get_payload_size(transfer);
+  unsigned char *payload;
+  int r;
+  int end = 0;
+  int flushed = 1;
 
-  if(transfer == NULL)
-  {
-    fprintf(stderr, _("Error: Memory allocation failed\n"));
-    return(NULL);
-  }
-  bzero(transfer, sizeof(struct dsss_transfer_s));
+  transmitter_init(&transmitter, transfer);
 
-  if(strcasecmp(radio_driver, "io") == 0)
+  if(transfer->pipeline > 0)
   {
-    transfer->radio_type = IO;
+    if(send_frames_pipelined(&transmitter))
+    {
+      transmitter_free(&transmitter);
+      return;
+    }
+    fprintf(stderr,
+            _("Error: Failed to start the transmit pipeline, using a single thread\n"));
   }
-  else if(strncasecmp(radio_driver, "file=", 5) == 0)
+
+  payload = malloc(payload_size);
+  if(payload == NULL)
   {
-    transfer->radio_type = FILENAME;
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
   }
-  else
+
+  while(!end && !is_stopped(transfer))
   {
-    transfer->radio_type = SOAPYSDR;
+    r = coalesce_payload(transfer, payload, payload_size, &end);
+    if(r > 0)
+    {
+      send_frame(&transmitter, payload, r);
+      flushed = 0;
+    }
+    else if(!end && !flushed)
+    {
+      /* No data for now. Send some dummy samples to get the remaining
+       * output samples for the end of current frame (because of resampler
+       * and filter delays) and send them, only once per idle period */
+      send_dummy_samples(&transmitter, 0);
+      flushed = 1;
+    }
   }
 
-  transfer->stop = 0;
-  transfer->emit = emit;
-  transfer->file = NULL;
-  transfer->data_callback = data_callback;
-  transfer->callback_context = callback_context;
+  /* Send some dummy samples to get the remaining output samples (because of
+   * resampler and filter delays) */
+  send_dummy_samples(&transmitter, 1);
 
-  if(sample_rate != 0)
+  free(payload);
+  transmitter_free(&transmitter);
+}
+
+/* Find the route of an id. If there is no route for this id and 'create' is
+ * not 0, add a new route without callback.
+ * The routes mutex must be held. */
+struct id_route_s * find_route(dsss_transfer_t transfer, char *id, int create)
+{
+  struct id_route_s *routes;
+  struct id_route_s *route;
+  unsigned int i;
+
+  for(i = 0; i < transfer->routes_size; i++)
   {
-    transfer->sample_rate = sample_rate * ((1000000.0 - ppm) / 1000000.0);
+    if(memcmp(transfer->routes[i].stats.id, id, 4) == 0)
+    {
+      return(&transfer->routes[i]);
+    }
   }
-  else
+  if(!create || (transfer->routes_size >= MAX_ROUTES))
   {
-    fprintf(stderr, _("Error: Invalid sample rate\n"));
-    free(transfer);
     return(NULL);
   }
 
-  if(frequency != 0)
-  {
-    transfer->frequency = frequency * ((1000000.0 - ppm) / 1000000.0);
-  }
-  else
+  routes = realloc(transfer->routes,
+                   (transfer->routes_size + 1) * sizeof(struct id_route_s));
+  if(routes == NULL)
   {
-    fprintf(stderr, _("Error: Invalid frequency\n"));
-    free(transfer);
     return(NULL);
   }
+  transfer->routes = routes;
+  route = &routes[transfer->routes_size];
+  transfer->routes_size++;
+  bzero(route, sizeof(struct id_route_s));
+  memcpy(route->stats.id, id, 4);
+  route->stats.id[4] = '\0';
 
-  transfer->frequency_offset = frequency_offset;
+  return(route);
+}
 
-  if(audio)
+/* Pass a frame to the callback registered for its id, or to the callback
+ * for any id, and update the statistics of the id */
+void route_frame(dsss_transfer_t transfer,
+                 char *id,
+                 unsigned int counter,
+                 unsigned char *payload,
+                 unsigned int payload_size,
+                 int payload_valid,
+                 framesyncstats_s *stats)
+{
+  struct id_route_s *route;
+  dsss_transfer_id_callback callback = NULL;
+  void *context = NULL;
+
+  pthread_mutex_lock(&transfer->routes_mutex);
+  route = find_route(transfer, id, transfer->any_id_callback != NULL);
+  if(route)
   {
-    if((transfer->radio_type == IO) || (transfer->radio_type == FILENAME))
+    if((route->stats.frames + route->stats.corrupted > 0) &&
+       (counter > route->last_counter + 1))
     {
-      transfer->audio_converter = firhilbf_create(25, 60);
-      /* The rate of audio samples is twice the rate of IQ samples */
-      transfer->sample_rate = transfer->sample_rate / 2;
-      /* -(sample_rate / 2) Hz IQ <=> 0 Hz audio
-       * (sample_rate / 2) Hz IQ <=> (sample_rate * 2) Hz audio */
-      transfer->frequency_offset = transfer->frequency - (transfer->sample_rate / 2);
-      transfer->frequency = 0;
-      gain_value = strtol(gain, NULL, 10);
-      transfer->audio_gain = powf(10, gain_value / 20.0);
+      route->stats.lost += counter - route->last_counter - 1;
+    }
+    route->last_counter = counter;
+    route->stats.rssi = stats->rssi;
+    route->stats.evm = stats->evm;
+    if(payload_valid)
+    {
+      route->stats.frames++;
+      route->stats.bytes += payload_size;
     }
     else
     {
-      fprintf(stderr, _("Error: This radio type only supports IQ samples\n"));
-      free(transfer);
-      return(NULL);
+      route->stats.corrupted++;
     }
+    callback = route->callback;
+    context = route->context;
   }
-  else
+  if(callback == NULL)
   {
-    transfer->audio_converter = NULL;
-    transfer->audio_gain = 0;
+    callback = transfer->any_id_callback;
+    context = transfer->any_id_context;
   }
+  pthread_mutex_unlock(&transfer->routes_mutex);
 
-  if(bit_rate != 0)
+  if(payload_valid)
   {
-    transfer->bit_rate = bit_rate;
+    if(callback)
+    {
+      if(transfer->delivery)
+      {
+        delivery_push(transfer->delivery,
+                      callback,
+                      context,
+                      id,
+                      payload,
+                      payload_size);
+      }
+      else
+      {
+        callback(context, id, payload, payload_size);
+      }
+      pthread_mutex_lock(&transfer->stats_mutex);
+      transfer->stats.frames++;
+      transfer->stats.bytes += payload_size;
+      pthread_mutex_unlock(&transfer->stats_mutex);
+    }
+    else
+    {
+      count_stat(transfer, &transfer->stats.foreign_frames, 1);
+      if(transfer->verbose)
+      {
+        fprintf(stderr, _("Frame %u for '%s': ignored\n"), counter, id);
+        fflush(stderr);
+      }
+    }
+  }
+}
+
+/* Pass a payload from the delivery queue to the data callback */
+int deliver_data(void *context,
+                 char *id,
+                 unsigned char *payload,
+                 unsigned int payload_size)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) context;
+
+  (void) id;
+
+  return(transfer->data_callback(transfer->callback_context,
+                                 payload,
+                                 payload_size));
+}
+
+/* Count the errors and the quality of a received frame */
+void update_frame_stats(dsss_transfer_t transfer,
+                        int header_valid,
+                        int payload_valid,
+                        framesyncstats_s *stats)
+{
+  /* Rate of the samples given to the frame synchronizer */
+  float rate = transfer->bit_rate * transfer->spreading_factor * 2;
+
+  pthread_mutex_lock(&transfer->stats_mutex);
+  if(!header_valid)
+  {
+    transfer->stats.header_errors++;
   }
   else
   {
-    fprintf(stderr, _("Error: Invalid bit rate\n"));
-    free(transfer);
-    return(NULL);
+    if(!payload_valid)
+    {
+      transfer->stats.payload_errors++;
+    }
+    if((transfer->measured_frames == 0) ||
+       (stats->evm > transfer->stats.evm_worst))
+    {
+      transfer->stats.evm_worst = stats->evm;
+    }
+    transfer->measured_frames++;
+    transfer->evm_sum += stats->evm;
+    transfer->rssi_sum += stats->rssi;
+    transfer->cfo_sum += stats->cfo * rate / TAU;
   }
+  pthread_mutex_unlock(&transfer->stats_mutex);
+}
 
-  if(spreading_factor >= 2)
+/* Trigger the recorder if the frame is one of the selected events */
+void record_frame(dsss_transfer_t transfer, int header_valid, int payload_valid)
+{
+  unsigned int event;
+
+  if(!header_valid)
   {
-    transfer->spreading_factor = spreading_factor;
+    event = RECORD_HEADER_ERRORS;
+  }
+  else if(!payload_valid)
+  {
+    event = RECORD_PAYLOAD_ERRORS;
   }
   else
   {
-    fprintf(stderr, _("Error: Invalid spreading factor\n"));
-    free(transfer);
-    return(NULL);
+    event = RECORD_VALID_FRAMES;
   }
-
-  transfer->crc = LIQUID_CRC_32;
-
-  transfer->inner_fec = liquid_getopt_str2fec(inner_fec);
-  if(transfer->inner_fec == LIQUID_FEC_UNKNOWN)
+  if(transfer->recorder_events & event)
   {
-    fprintf(stderr, _("Error: Invalid inner FEC\n"));
-    free(transfer);
-    return(NULL);
+    recorder_trigger(transfer->recorder);
   }
+}
 
-  transfer->outer_fec = liquid_getopt_str2fec(outer_fec);
-  if(transfer->outer_fec == LIQUID_FEC_UNKNOWN)
+int frame_received(unsigned char *header,
+                   int header_valid,
+                   unsigned char *payload,
+                   unsigned int payload_size,
+                   int payload_valid,
+                   framesyncstats_s stats,
+                   void *user_data)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) user_data;
+  char id[5];
+  unsigned int counter;
+  int demultiplex;
+
+  atomic_store(&transfer->timeout_start, time(NULL));
+  memcpy(id, header, 4);
+  id[4] = '\0';
+  counter = get_counter(header);
+  update_frame_stats(transfer, header_valid, payload_valid, &stats);
+  if(transfer->recorder)
   {
-    fprintf(stderr, _("Error: Invalid outer FEC\n"));
-    free(transfer);
-    return(NULL);
+    record_frame(transfer, header_valid, payload_valid);
   }
 
-  if(strlen(id) <= 4)
+  /* The routes can be added by another thread while receiving */
+  pthread_mutex_lock(&transfer->routes_mutex);
+  demultiplex = (transfer->routes_size > 0) || transfer->any_id_callback;
+  pthread_mutex_unlock(&transfer->routes_mutex);
+
+  if(header_valid && demultiplex)
   {
-    strcpy(transfer->id, id);
+    /* Demultiplexing mode */
+    if(!payload_valid && transfer->verbose)
+    {
+      fprintf(stderr, _("Frame %u for '%s': corrupted payload\n"), counter, id);
+      fflush(stderr);
+    }
+    TIMING_START(start);
+    route_frame(transfer,
+                id,
+                counter,
+                payload,
+                payload_size,
+                payload_valid,
+                &stats);
+    TIMING_STOP(transfer->timing, TIMING_CALLBACK, start);
   }
-  else
+  else if(!header_valid || !payload_valid)
   {
-    fprintf(stderr, _("Error: Id must be at most 4 bytes long\n"));
-    free(transfer);
-    return(NULL);
+    if(transfer->verbose)
+    {
+      if(!header_valid)
+      {
+        fprintf(stderr, _("Frame %u for '%s': corrupted header\n"), counter, id);
+      }
+      if(!payload_valid)
+      {
+        fprintf(stderr, _("Frame %u for '%s': corrupted payload\n"), counter, id);
+      }
+      fflush(stderr);
+    }
   }
-
-  if(dump)
+  else if(memcmp(id, transfer->id, 4) != 0)
   {
-    transfer->dump = fopen(dump, "wb");
-    if(transfer->dump == NULL)
+    count_stat(transfer, &transfer->stats.foreign_frames, 1);
+    if(transfer->verbose)
     {
-      fprintf(stderr, _("Error: Failed to open '%s'\n"), dump);
-      free(transfer);
-      return(NULL);
+      fprintf(stderr, _("Frame %u for '%s': ignored\n"), counter, id);
+      fflush(stderr);
     }
   }
   else
   {
-    transfer->dump = NULL;
+    TIMING_START(start);
+    if(transfer->delivery)
+    {
+      delivery_push(transfer->delivery,
+                    deliver_data,
+                    transfer,
+                    id,
+                    payload,
+                    payload_size);
+    }
+    else
+    {
+      transfer->data_callback(transfer->callback_context, payload, payload_size);
+    }
+    TIMING_STOP(transfer->timing, TIMING_CALLBACK, start);
+    pthread_mutex_lock(&transfer->stats_mutex);
+    transfer->stats.frames++;
+    transfer->stats.bytes += payload_size;
+    pthread_mutex_unlock(&transfer->stats_mutex);
   }
+  return(0);
+}
 
-  transfer->timeout = timeout;
+/* Energy squelch skipping the frame detection when the channel is idle */
+struct squelch_s
+{
+  /* Level above the noise floor opening the squelch, as a power ratio */
+  float threshold;
+  float noise_floor;
+  /* Last block skipped, given to the frame synchronizer before the next
+   * block when the squelch opens, so that a preamble starting at the end of
+   * a skipped block can still be detected */
+  complex float *history;
+  unsigned int history_size;
+  unsigned long int blocks;
+  unsigned long int skipped_blocks;
+  unsigned long long int skipped_samples;
+  /* Time spent looking for frames, used to estimate the time saved */
+  double detection_time;
+  unsigned long long int detection_samples;
+};
 
-  switch(transfer->radio_type)
-  {
-  case IO:
-    break;
+struct receiver_s
+{
+  dsss_transfer_t transfer;
+  msresamp_crcf resampler;
+  unsigned int delay;
+  nco_crcf oscillator;
+  mixer_t mixer;
+  complex float *converted;
+  decimator_t decimator;
+  complex float *decimated;
+  dsssframesync frame_synchronizer;
+  /* Version of the routes used by the id filter */
+  unsigned int routes_version;
+  /* Frames skipped by the id filter already added to the statistics */
+  unsigned int filtered_frames;
+  unsigned int samples_size;
+  unsigned int frame_samples_size;
+  ring_t radio_queue;
+  ring_t dsp_queue;
+  struct squelch_s squelch;
+};
 
-  case FILENAME:
-    if(emit)
+/* Decimation factor used by the fused front end for a resampling ratio.
+ * After the decimation, the sample rate stays at least twice the rate of the
+ * frame synchronizer. */
+unsigned int get_decimation_factor(float resampling_ratio)
+{
+  return(floorf(0.5 / resampling_ratio));
+}
+
+/* Create the decimator of the fused front end, which replaces the separate
+ * frequency shift and the first stages of the resampler. The receiver keeps
+ * using the separate stages if the decimation factor is too small. */
+void decimator_init(struct receiver_s *receiver, float resampling_ratio)
+{
+  dsss_transfer_t transfer = receiver->transfer;
+  unsigned int decimation = get_decimation_factor(resampling_ratio);
+  unsigned int taps_size;
+  float transition;
+  float sum;
+  unsigned int i;
+
+  if(decimation < 2)
+  {
+    if(transfer->verbose)
     {
-      transfer->radio_device.file = fopen(radio_driver + 5, "wb");
+      fprintf(stderr,
+              _("Info: Sample rate too low for the fused front end\n"));
     }
-    else
+    return;
+  }
+
+  /* Keep the band of the frame synchronizer free of aliases: the pass band
+   * ends at half its rate, the stop band starts where the first alias of
+   * the pass band begins */
+  transition = (1.0 / decimation) - resampling_ratio;
+  taps_size = estimate_req_filter_len(transition, 60);
+  {
+    float taps[taps_size];
+
+    liquid_firdes_kaiser(taps_size, 0.5 / decimation, 60, 0, taps);
+    for(sum = 0, i = 0; i < taps_size; i++)
     {
-      transfer->radio_device.file = fopen(radio_driver + 5, "rb");
+      sum += taps[i];
     }
-    if(transfer->radio_device.file == NULL)
+    for(i = 0; i < taps_size; i++)
     {
-      fprintf(stderr, _("Error: Failed to open '%s'\n"), radio_driver + 5);
-      free(transfer);
-      return(NULL);
+      taps[i] /= sum;
     }
-    break;
+    receiver->decimator = decimator_create(decimation,
+                                           taps,
+                                           taps_size,
+                                           TAU * ((double) transfer->frequency_offset /
+                                                  transfer->sample_rate));
+  }
+  if(receiver->decimator == NULL)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
+  }
+  if(transfer->verbose)
+  {
+    fprintf(stderr,
+            _("Info: Fused front end: decimation %u, %u taps\n"),
+            decimation,
+            taps_size);
+  }
+}
 
-  case SOAPYSDR:
-    transfer->radio_device.soapysdr = SoapySDRDevice_makeStrArgs(radio_driver);
-    if(transfer->radio_device.soapysdr == NULL)
-    {
-      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
-      free(transfer);
-      return(NULL);
-    }
-    direction = emit ? SOAPY_SDR_TX : SOAPY_SDR_RX;
-    SOAPYSDR_CHECK(SoapySDRDevice_setSampleRate(transfer->radio_device.soapysdr,
-                                                direction,
-                                                0,
-                                                transfer->sample_rate));
-    SOAPYSDR_CHECK(SoapySDRDevice_setFrequency(transfer->radio_device.soapysdr,
-                                               direction,
-                                               0,
-                                               transfer->frequency - transfer->frequency_offset,
-                                               NULL));
-    if(strchr(gain, '='))
+/* Make the frame synchronizer skip the payload of the frames that would be
+ * ignored by frame_received() anyway */
+void set_id_filter(dsss_transfer_t transfer, dsssframesync frame_synchronizer)
+{
+  unsigned char ids[4 * MAX_ROUTES];
+  unsigned int ids_size = 0;
+  unsigned int i;
+
+  pthread_mutex_lock(&transfer->routes_mutex);
+  if(transfer->any_id_callback)
+  {
+    /* All the ids are wanted, an empty filter decodes all the frames */
+  }
+  else if(transfer->routes_size == 0)
+  {
+    memcpy(ids, transfer->id, 4);
+    ids_size = 1;
+  }
+  else
+  {
+    for(i = 0; i < transfer->routes_size; i++)
     {
-      kwargs = SoapySDRKwargs_fromString(gain);
-      for(n = 0; n < kwargs.size; n++)
+      if(transfer->routes[i].callback)
       {
-        gain_name = kwargs.keys[n];
-        gain_value = strtoul(kwargs.vals[n], NULL, 10);
-        SOAPYSDR_CHECK(SoapySDRDevice_setGainElement(transfer->radio_device.soapysdr,
-                                                     direction,
-                                                     0,
-                                                     gain_name,
-                                                     gain_value));
+        memcpy(ids + 4 * ids_size, transfer->routes[i].stats.id, 4);
+        ids_size++;
       }
-      SoapySDRKwargs_clear(&kwargs);
-    }
-    else
-    {
-      gain_value = strtoul(gain, NULL, 10);
-      SOAPYSDR_CHECK(SoapySDRDevice_setGain(transfer->radio_device.soapysdr,
-                                            direction,
-                                            0,
-                                            gain_value));
-    }
-    transfer->radio_stream.soapysdr = SoapySDRDevice_setupStream(transfer->radio_device.soapysdr,
-                                                                 direction,
-                                                                 SOAPY_SDR_CF32,
-                                                                 NULL,
-                                                                 0,
-                                                                 NULL);
-    if(transfer->radio_stream.soapysdr == NULL)
-    {
-      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
-      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
-      free(transfer);
-      return(NULL);
     }
-    break;
+  }
+  pthread_mutex_unlock(&transfer->routes_mutex);
+  dsssframesync_set_id_filter(frame_synchronizer, ids, ids_size);
+}
 
-  default:
-    fprintf(stderr, _("Error: Unknown radio type\n"));
-    free(transfer);
-    return(NULL);
-    break;
+/* Set the id filter of a frame synchronizer again if callbacks were added
+ * since 'version' */
+void update_id_filter(dsss_transfer_t transfer,
+                      dsssframesync frame_synchronizer,
+                      unsigned int *version)
+{
+  unsigned int v = atomic_load(&transfer->routes_version);
+
+  if(v != *version)
+  {
+    *version = v;
+    set_id_filter(transfer, frame_synchronizer);
   }
+}
 
-  return(transfer);
+dsssframesync create_frame_synchronizer(dsss_transfer_t transfer,
+                                        framesync_callback callback,
+                                        void *user_data)
+{
+  dsssframesync frame_synchronizer;
+  dsssframegenprops_s frame_properties;
+  unsigned int header_size = 8;
+
+  frame_synchronizer = dsssframesync_create_set(transfer->spreading_factor,
+                                                callback,
+                                                user_data);
+  frame_properties.check = transfer->crc;
+  frame_properties.fec0 = transfer->inner_fec;
+  frame_properties.fec1 = transfer->outer_fec;
+  dsssframesync_set_header_props(frame_synchronizer, &frame_properties);
+  dsssframesync_set_header_len(frame_synchronizer, header_size);
+  set_id_filter(transfer, frame_synchronizer);
+
+  return(frame_synchronizer);
 }
 
-dsss_transfer_t dsss_transfer_create(char *radio_driver,
-                                     unsigned char emit,
-                                     char *file,
-                                     unsigned long int sample_rate,
-                                     unsigned int bit_rate,
-                                     unsigned long int frequency,
-                                     long int frequency_offset,
-                                     char *gain,
-                                     float ppm,
-                                     unsigned int spreading_factor,
-                                     char *inner_fec,
-                                     char *outer_fec,
-                                     char *id,
-                                     char *dump,
-                                     unsigned int timeout,
-                                     unsigned char audio)
+/* Add the frames skipped by the id filter of a frame synchronizer since the
+ * last call to the statistics */
+void count_filtered_frames(dsss_transfer_t transfer,
+                           dsssframesync frame_synchronizer,
+                           unsigned int *counted)
 {
-  int flags;
-  dsss_transfer_t transfer;
+  unsigned int n = dsssframesync_get_num_filtered(frame_synchronizer);
 
-  transfer = dsss_transfer_create_callback(radio_driver,
-                                           emit,
-                                           emit ? read_data : write_data,
-                                           NULL,
-                                           sample_rate,
-                                           bit_rate,
-                                           frequency,
-                                           frequency_offset,
-                                           gain,
-                                           ppm,
-                                           spreading_factor,
-                                           inner_fec,
-                                           outer_fec,
-                                           id,
-                                           dump,
-                                           timeout,
-                                           audio);
-  if(transfer == NULL)
+  if(n != *counted)
   {
-    return(NULL);
+    count_stat(transfer, &transfer->stats.foreign_frames, n - *counted);
+    *counted = n;
   }
+}
 
-  transfer->callback_context = transfer;
-  if(file)
+void receiver_init(struct receiver_s *receiver,
+                   dsss_transfer_t transfer,
+                   framesync_callback callback,
+                   void *user_data)
+{
+  unsigned int samples_per_symbol = 2;
+  float samples_per_bit = transfer->spreading_factor * samples_per_symbol;
+  float resampling_ratio = (transfer->bit_rate *
+                            samples_per_bit) / (float) transfer->sample_rate;
+  unsigned int decimation;
+
+  receiver->transfer = transfer;
+  /* Process data by blocks of 'block_duration' (50 ms by default) */
+  receiver->frame_samples_size = ceilf((transfer->bit_rate *
+                                        samples_per_bit *
+                                        transfer->block_duration) / 1000.0);
+  receiver->samples_size = floorf(receiver->frame_samples_size /
+                                  resampling_ratio);
+  receiver->radio_queue = NULL;
+  receiver->dsp_queue = NULL;
+  receiver->filtered_frames = 0;
+  receiver->routes_version = atomic_load(&transfer->routes_version);
+  receiver->decimator = NULL;
+  receiver->decimated = NULL;
+  /* With the direct audio modem, the real audio samples are always shifted
+   * and decimated first, so that only a fraction of the filter outputs is
+   * computed at the audio rate */
+  if(transfer->fused_frontend || transfer->direct_audio)
   {
-    if(emit)
-    {
-      transfer->file = fopen(file, "rb");
-    }
-    else
-    {
-      transfer->file = fopen(file, "wb");
-    }
-    if(transfer->file == NULL)
+    decimator_init(receiver, resampling_ratio);
+  }
+  if(receiver->decimator)
+  {
+    /* The resampler only does the remaining part of the rate change, and
+     * the delay is counted in samples at the input of the decimator */
+    decimation = decimator_get_factor(receiver->decimator);
+    receiver->resampler = msresamp_crcf_create(resampling_ratio * decimation,
+                                               60);
+    receiver->delay = decimator_get_length(receiver->decimator) +
+      decimation * ceilf(msresamp_crcf_get_delay(receiver->resampler));
+    receiver->decimated = malloc(((receiver->samples_size + receiver->delay) /
+                                  decimation + 1) *
+                                 sizeof(complex float));
+    if(receiver->decimated == NULL)
     {
-      fprintf(stderr, _("Error: Failed to open '%s'\n"), file);
-      free(transfer);
-      return(NULL);
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      exit(EXIT_FAILURE);
     }
   }
   else
   {
-    if(emit)
+    receiver->resampler = msresamp_crcf_create(resampling_ratio, 60);
+    receiver->delay = ceilf(msresamp_crcf_get_delay(receiver->resampler));
+  }
+
+  receiver->oscillator = nco_crcf_create(LIQUID_NCO);
+  nco_crcf_set_phase(receiver->oscillator, 0);
+  nco_crcf_set_frequency(receiver->oscillator,
+                         TAU * ((float) transfer->frequency_offset /
+                                transfer->sample_rate));
+  mixer_init(&receiver->mixer,
+             TAU * ((float) transfer->frequency_offset /
+                    transfer->sample_rate));
+  if((transfer->sample_format == SAMPLE_FORMAT_CF32) &&
+     (transfer->mapped_file == NULL))
+  {
+    receiver->converted = NULL;
+  }
+  else
+  {
+    receiver->converted = malloc(receiver->samples_size *
+                                 sizeof(complex float));
+    if(receiver->converted == NULL)
     {
-      transfer->file = stdin;
-      flags = fcntl(STDIN_FILENO, F_GETFL);
-      fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      exit(EXIT_FAILURE);
     }
-    else
+  }
+
+  receiver->frame_synchronizer = create_frame_synchronizer(transfer,
+                                                           callback,
+                                                           user_data);
+
+  bzero(&receiver->squelch, sizeof(struct squelch_s));
+  if(transfer->squelch > 0)
+  {
+    receiver->squelch.threshold = powf(10, transfer->squelch / 10);
+    receiver->squelch.history = malloc((receiver->frame_samples_size +
+                                        receiver->delay) *
+                                       sizeof(complex float));
+    if(receiver->squelch.history == NULL)
     {
-      transfer->file = stdout;
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      exit(EXIT_FAILURE);
     }
   }
+}
 
-  return(transfer);
+void receiver_free(struct receiver_s *receiver)
+{
+  free(receiver->squelch.history);
+  free(receiver->converted);
+  free(receiver->decimated);
+  decimator_free(receiver->decimator);
+  nco_crcf_destroy(receiver->oscillator);
+  msresamp_crcf_destroy(receiver->resampler);
+  dsssframesync_destroy(receiver->frame_synchronizer);
+  ring_free(receiver->radio_queue);
+  ring_free(receiver->dsp_queue);
 }
 
-void dsss_transfer_free(dsss_transfer_t transfer)
+/* Check whether the reception must end after getting 'n' samples, otherwise
+ * dump and count them.
+ * Return 'n', or -1 if the reception must end. */
+int check_samples(dsss_transfer_t transfer,
+                  const void *samples,
+                  unsigned int n)
 {
-  if(transfer)
+  if((n == 0) &&
+     ((transfer->radio_type == IO) ||
+      (transfer->radio_type == FILENAME) ||
+      (transfer->radio_type == LOOPBACK)))
   {
-    if(transfer->file)
-    {
-      fclose(transfer->file);
-    }
-    if(transfer->dump)
-    {
-      fclose(transfer->dump);
-    }
-    if(transfer->audio_converter)
+    return(-1);
+  }
+  if((transfer->timeout > 0) &&
+     (time(NULL) > atomic_load(&transfer->timeout_start) + transfer->timeout))
+  {
+    if(transfer->verbose)
     {
-      firhilbf_destroy(transfer->audio_converter);
+      fprintf(stderr, _("Timeout: %d s without frames\n"), transfer->timeout);
     }
-    switch(transfer->radio_type)
-    {
-    case IO:
-      break;
-
-    case FILENAME:
-      fclose(transfer->radio_device.file);
-      break;
+    return(-1);
+  }
+  if(transfer->dump_writer)
+  {
+    dump_samples(transfer, samples, n);
+  }
+  if(transfer->recorder)
+  {
+    recorder_push(transfer->recorder, samples, n);
+  }
+  count_stat(transfer, &transfer->stats.samples, n);
+  return(n);
+}
 
-    case SOAPYSDR:
-      SoapySDRDevice_deactivateStream(transfer->radio_device.soapysdr,
-                                      transfer->radio_stream.soapysdr,
-                                      0,
-                                      0);
-      SoapySDRDevice_closeStream(transfer->radio_device.soapysdr,
-                                 transfer->radio_stream.soapysdr);
-      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
-      break;
+/* Get at most 'samples_size' samples from the radio.
+ * Return the number of samples, or -1 if the reception must end. */
+int read_samples(dsss_transfer_t transfer,
+                 void *samples,
+                 unsigned int samples_size)
+{
+  unsigned int n;
+  TIMING_START(start);
 
-    default:
-      break;
-    }
-    // Set pointers to NULL to avoid double-free if free is called again or checked.
-    transfer->radio_device.soapysdr = NULL; 
-    transfer->radio_stream.soapysdr = NULL;
-    
-    free(transfer);
-  }
+  n = receive_from_radio(transfer, samples, samples_size);
+  TIMING_STOP(transfer->timing, TIMING_RADIO, start);
+  TIMING_SIGNAL(transfer->timing, n, transfer->sample_rate);
+  return(check_samples(transfer, samples, n));
 }
 
-void dsss_transfer_start(dsss_transfer_t transfer)
+/* Get some samples from the radio in 'buffer' and put their address in
+ * 'samples'. When the recording is mapped in memory, the samples are not
+ * copied and 'samples' points to them in the mapping.
+ * Return the number of samples, or -1 if the reception must end. */
+int receive_samples(struct receiver_s *receiver, void *buffer, void **samples)
 {
-  stop = 0;
-  transfer->stop = 0;
+  dsss_transfer_t transfer = receiver->transfer;
+  const void *data;
+  unsigned int n;
+  TIMING_START(start);
 
-  switch(transfer->radio_type)
+  if(transfer->mapped_file == NULL)
   {
-  case IO:
-    if(verbose)
-    {
-      fprintf(stderr, _("Info: Using IO pseudo-radio\n"));
-    }
-    break;
-
-  case FILENAME:
-    if(verbose)
-    {
-      fprintf(stderr, _("Info: Using FILENAME pseudo-radio\n"));
-    }
-    break;
+    *samples = buffer;
+    return(read_samples(transfer, buffer, receiver->samples_size));
+  }
+  n = map_samples(transfer, &data, receiver->samples_size);
+  TIMING_STOP(transfer->timing, TIMING_RADIO, start);
+  TIMING_SIGNAL(transfer->timing, n, transfer->sample_rate);
+  /* The mapping is read only, but downconvert_samples() doesn't modify the
+   * samples of a mapped recording */
+  *samples = (void *) data;
+  return(check_samples(transfer, data, n));
+}
 
-  case SOAPYSDR:
-    SoapySDRDevice_activateStream(transfer->radio_device.soapysdr,
-                                  transfer->radio_stream.soapysdr,
-                                  0,
-                                  0,
-                                  0);
-    break;
+/* Convert the samples from the format of the radio, shift the signal to
+ * baseband and resample it to the rate of the frame synchronizer.
+ * The content of 'samples' can be modified, unless they come from a
+ * recording mapped in memory. */
+unsigned int downconvert_samples(struct receiver_s *receiver,
+                                 void *samples,
+                                 unsigned int samples_size,
+                                 complex float *frame_samples)
+{
+  dsss_transfer_t transfer = receiver->transfer;
+  complex float *input = samples;
+  unsigned int n;
+  TIMING_START(start);
 
-  default:
-    return;
+  if(receiver->decimator)
+  {
+    /* Conversion, frequency shift and decimation in one pass */
+    n = decimator_execute(receiver->decimator,
+                          transfer->sample_format,
+                          samples,
+                          samples_size,
+                          receiver->decimated);
+    input = receiver->decimated;
+    samples_size = n;
   }
-
-  transfer->timeout_start = time(NULL);
-  if(transfer->emit)
+  else if((transfer->sample_format != SAMPLE_FORMAT_CF32) ||
+          ((transfer->frequency_offset != 0) && transfer->mapped_file))
   {
-    send_frames(transfer);
+    /* Conversion and frequency shift in one pass. The samples of a mapped
+     * recording are shifted to another buffer. */
+    kernel_convert_mix_down(transfer->sample_format,
+                            samples,
+                            receiver->converted,
+                            samples_size,
+                            (transfer->frequency_offset != 0) ?
+                            &receiver->mixer :
+                            NULL);
+    input = receiver->converted;
   }
-  else
+  else if(transfer->frequency_offset != 0)
   {
-    receive_frames(transfer);
+    nco_crcf_mix_block_down(receiver->oscillator,
+                            samples,
+                            samples,
+                            samples_size);
   }
+  msresamp_crcf_execute(receiver->resampler,
+                        input,
+                        samples_size,
+                        frame_samples,
+                        &n);
+  TIMING_STOP(transfer->timing, TIMING_FRONTEND, start);
+  return(n);
 }
 
-void dsss_transfer_stop(dsss_transfer_t transfer)
+/* Send some dummy samples to the resampler to get the remaining output
+ * samples (because of resampler and filter delays) */
+unsigned int flush_samples(struct receiver_s *receiver,
+                           complex float *samples,
+                           complex float *frame_samples)
 {
-  transfer->stop = 1;
-  if(transfer->radio_type == SOAPYSDR && transfer->radio_device.soapysdr && transfer->radio_stream.soapysdr)
+  unsigned int n;
+
+  for(n = 0; n < receiver->delay; n++)
   {
-      SoapySDRDevice_deactivateStream(transfer->radio_device.soapysdr,
-                                      transfer->radio_stream.soapysdr,
-                                      0,
-                                      0);
+    samples[n] = 0;
+  }
+  if(receiver->decimator)
+  {
+    n = decimator_execute(receiver->decimator,
+                          SAMPLE_FORMAT_CF32,
+                          samples,
+                          receiver->delay,
+                          receiver->decimated);
+    msresamp_crcf_execute(receiver->resampler,
+                          receiver->decimated,
+                          n,
+                          frame_samples,
+                          &n);
+    return(n);
   }
+  msresamp_crcf_execute(receiver->resampler,
+                        samples,
+                        receiver->delay,
+                        frame_samples,
+                        &n);
+  return(n);
 }
 
-void dsss_transfer_stop_all()
+/* Give the samples to the frame synchronizer, unless the squelch is closed.
+ * The squelch is closed when no frame is being received and the energy of
+ * the block is below the threshold above the noise floor. The noise floor
+ * follows the decreases of the energy immediately, and the increases
+ * slowly. */
+void synchronize_samples(struct receiver_s *receiver,
+                         complex float *frame_samples,
+                         unsigned int frame_samples_size)
 {
-  stop = 1;
+  struct squelch_s *squelch = &receiver->squelch;
+  float energy = 0;
+  double start;
+  int detecting;
+  unsigned int history_size;
+  TIMING_START(timing_start);
+
+  update_id_filter(receiver->transfer,
+                   receiver->frame_synchronizer,
+                   &receiver->routes_version);
+  if((squelch->threshold == 0) || (frame_samples_size == 0))
+  {
+    dsssframesync_execute_filtered(receiver->frame_synchronizer,
+                                   frame_samples,
+                                   frame_samples_size);
+    count_filtered_frames(receiver->transfer,
+                          receiver->frame_synchronizer,
+                          &receiver->filtered_frames);
+    TIMING_STOP(receiver->transfer->timing, TIMING_FRAMING, timing_start);
+    return;
+  }
+
+  squelch->blocks++;
+  detecting = !dsssframesync_is_frame_open(receiver->frame_synchronizer);
+  if(detecting)
+  {
+    energy = kernel_power(frame_samples, frame_samples_size, NULL) /
+      frame_samples_size;
+    if((squelch->blocks == 1) || (energy < squelch->noise_floor))
+    {
+      squelch->noise_floor = energy;
+    }
+    else
+    {
+      squelch->noise_floor += (energy - squelch->noise_floor) * 0.01;
+    }
+
+    if((squelch->blocks > 1) &&
+       (energy < squelch->noise_floor * squelch->threshold))
+    {
+      memcpy(squelch->history,
+             frame_samples,
+             frame_samples_size * sizeof(complex float));
+      squelch->history_size = frame_samples_size;
+      squelch->skipped_blocks++;
+      squelch->skipped_samples += frame_samples_size;
+      TIMING_STOP(receiver->transfer->timing, TIMING_FRAMING, timing_start);
+      return;
+    }
+  }
+
+  start = timing_now();
+  history_size = squelch->history_size;
+  if(history_size > 0)
+  {
+    dsssframesync_execute_filtered(receiver->frame_synchronizer,
+                                   squelch->history,
+                                   history_size);
+    squelch->skipped_samples -= history_size;
+    squelch->history_size = 0;
+  }
+  dsssframesync_execute_filtered(receiver->frame_synchronizer,
+                                 frame_samples,
+                                 frame_samples_size);
+  if(detecting && !dsssframesync_is_frame_open(receiver->frame_synchronizer))
+  {
+    /* Blocks where only the frame detector did some work */
+    squelch->detection_time += timing_now() - start;
+    squelch->detection_samples += history_size + frame_samples_size;
+  }
+  count_filtered_frames(receiver->transfer,
+                        receiver->frame_synchronizer,
+                        &receiver->filtered_frames);
+  TIMING_STOP(receiver->transfer->timing, TIMING_FRAMING, timing_start);
+}
+
+void print_squelch_stats(struct receiver_s *receiver)
+{
+  struct squelch_s *squelch = &receiver->squelch;
+  double saved = 0;
+
+  if(!receiver->transfer->verbose || (squelch->threshold == 0) || (squelch->blocks == 0))
+  {
+    return;
+  }
+  if(squelch->detection_samples > 0)
+  {
+    saved = squelch->skipped_samples *
+      (squelch->detection_time / squelch->detection_samples);
+  }
+  fprintf(stderr,
+          _("Info: Squelch: %lu of %lu blocks skipped (%.1f%%), about %.2f s of frame detection saved\n"),
+          squelch->skipped_blocks,
+          squelch->blocks,
+          100.0 * squelch->skipped_blocks / squelch->blocks,
+          saved);
+}
+
+void flush_frame_synchronizer(struct receiver_s *receiver)
+{
+  complex float zero_sample = 0;
+
+  while(dsssframesync_is_frame_open(receiver->frame_synchronizer))
+  {
+    dsssframesync_execute_filtered(receiver->frame_synchronizer, &zero_sample, 1);
+  }
+  count_filtered_frames(receiver->transfer,
+                        receiver->frame_synchronizer,
+                        &receiver->filtered_frames);
+}
+
+void * receive_radio_stage(void *arg)
+{
+  struct receiver_s *receiver = (struct receiver_s *) arg;
+  dsss_transfer_t transfer = receiver->transfer;
+  void *samples;
+  int r;
+
+  while(!is_stopped(transfer))
+  {
+    samples = ring_write_begin(receiver->radio_queue);
+    if(samples == NULL)
+    {
+      break;
+    }
+    r = read_samples(transfer, samples, receiver->samples_size);
+    if(r < 0)
+    {
+      break;
+    }
+    ring_write_end(receiver->radio_queue, r * transfer->sample_size);
+  }
+  ring_close(receiver->radio_queue);
+
+  return(NULL);
+}
+
+void * receive_dsp_stage(void *arg)
+{
+  struct receiver_s *receiver = (struct receiver_s *) arg;
+  void *samples;
+  complex float *frame_samples;
+  complex float zero_samples[receiver->delay + 1];
+  unsigned int size;
+  unsigned int n;
+
+  while((samples = ring_read_begin(receiver->radio_queue, &size)) != NULL)
+  {
+    frame_samples = ring_write_begin(receiver->dsp_queue);
+    if(frame_samples == NULL)
+    {
+      ring_read_end(receiver->radio_queue);
+      /* The consumer is gone, stop the producer too */
+      ring_close(receiver->radio_queue);
+      return(NULL);
+    }
+    n = downconvert_samples(receiver,
+                            samples,
+                            size / receiver->transfer->sample_size,
+                            frame_samples);
+    ring_read_end(receiver->radio_queue);
+    ring_write_end(receiver->dsp_queue, n * sizeof(complex float));
+  }
+
+  frame_samples = ring_write_begin(receiver->dsp_queue);
+  if(frame_samples != NULL)
+  {
+    n = flush_samples(receiver, zero_samples, frame_samples);
+    ring_write_end(receiver->dsp_queue, n * sizeof(complex float));
+  }
+  ring_close(receiver->dsp_queue);
+
+  return(NULL);
+}
+
+/* Free the queues of a receive pipeline that could not be started, so that
+ * the receiver can work without them */
+void free_receive_queues(struct receiver_s *receiver)
+{
+  ring_free(receiver->radio_queue);
+  ring_free(receiver->dsp_queue);
+  receiver->radio_queue = NULL;
+  receiver->dsp_queue = NULL;
+}
+
+/* Receive using one thread for the radio, one thread for the frequency shift
+ * and resampling, and the current thread for the frame synchronization.
+ * Return 0 if the pipeline could not be started, before any sample has been
+ * read. */
+int receive_frames_pipelined(struct receiver_s *receiver)
+{
+  dsss_transfer_t transfer = receiver->transfer;
+  /* One slot per processing block */
+  unsigned int slots = MAX(2,
+                           (transfer->pipeline + transfer->block_duration - 1) /
+                           transfer->block_duration);
+  pthread_t radio_thread;
+  pthread_t dsp_thread;
+  complex float *frame_samples;
+  unsigned int size;
+  time_t report_time = time(NULL);
+
+  receiver->radio_queue = ring_create(slots,
+                                      (receiver->samples_size + receiver->delay) *
+                                      sizeof(complex float));
+  receiver->dsp_queue = ring_create(slots,
+                                    (receiver->frame_samples_size + receiver->delay) *
+                                    sizeof(complex float));
+  if((receiver->radio_queue == NULL) || (receiver->dsp_queue == NULL))
+  {
+    free_receive_queues(receiver);
+    return(0);
+  }
+  /* The DSP thread is started first, as it doesn't read any sample before
+   * the radio thread runs */
+  if(pthread_create(&dsp_thread, NULL, receive_dsp_stage, receiver) != 0)
+  {
+    free_receive_queues(receiver);
+    return(0);
+  }
+  if(pthread_create(&radio_thread, NULL, receive_radio_stage, receiver) != 0)
+  {
+    /* Both queues are closed, so the DSP thread stops without using the
+     * resampler */
+    ring_close(receiver->radio_queue);
+    ring_close(receiver->dsp_queue);
+    pthread_join(dsp_thread, NULL);
+    free_receive_queues(receiver);
+    return(0);
+  }
+
+  while((frame_samples = ring_read_begin(receiver->dsp_queue, &size)) != NULL)
+  {
+    synchronize_samples(receiver,
+                        frame_samples,
+                        size / sizeof(complex float));
+    ring_read_end(receiver->dsp_queue);
+    if(transfer->verbose && (time(NULL) >= report_time + 10))
+    {
+      report_time = time(NULL);
+      print_queue_depth(_("Radio"), receiver->radio_queue);
+      print_queue_depth(_("DSP"), receiver->dsp_queue);
+    }
+  }
+  flush_frame_synchronizer(receiver);
+
+  pthread_join(dsp_thread, NULL);
+  pthread_join(radio_thread, NULL);
+  if(transfer->verbose)
+  {
+    print_queue_depth(_("Radio"), receiver->radio_queue);
+    print_queue_depth(_("DSP"), receiver->dsp_queue);
+  }
+
+  return(1);
+}
+
+struct decoded_frame_s
+{
+  /* Number of the sample of the recording at the end of the block in which
+   * the frame was found */
+  unsigned long long int position;
+  unsigned char header[8];
+  int header_valid;
+  unsigned char *payload;
+  unsigned int payload_size;
+  int payload_valid;
+  framesyncstats_s stats;
+  struct decoded_frame_s *next;
+};
+
+struct chunk_s
+{
+  /* Samples belonging to the chunk, the decoding starts 'overlap' samples
+   * earlier to catch the frames straddling the previous chunk */
+  unsigned long long int start;
+  unsigned long long int end;
+  struct decoded_frame_s *frames;
+  struct decoded_frame_s *last_frame;
+  unsigned long long int position;
+  int done;
+};
+
+struct parallel_decoder_s
+{
+  dsss_transfer_t transfer;
+  int fd;
+  unsigned long long int overlap;
+  struct chunk_s *chunks;
+  unsigned int chunks_count;
+  unsigned int next_chunk;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+void free_decoded_frames(struct decoded_frame_s *frame)
+{
+  struct decoded_frame_s *next;
+
+  while(frame)
+  {
+    next = frame->next;
+    free(frame->payload);
+    free(frame);
+    frame = next;
+  }
+}
+
+int chunk_frame_received(unsigned char *header,
+                         int header_valid,
+                         unsigned char *payload,
+                         unsigned int payload_size,
+                         int payload_valid,
+                         framesyncstats_s stats,
+                         void *user_data)
+{
+  struct chunk_s *chunk = (struct chunk_s *) user_data;
+  struct decoded_frame_s *frame;
+
+  /* Invalid frames found before the start of the chunk are only parts of
+   * frames that are decoded completely by the previous chunk */
+  if((!header_valid || !payload_valid) && (chunk->position < chunk->start))
+  {
+    return(0);
+  }
+
+  frame = malloc(sizeof(struct decoded_frame_s));
+  if(frame == NULL)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
+  }
+  frame->position = chunk->position;
+  memcpy(frame->header, header, 8);
+  frame->header_valid = header_valid;
+  frame->payload_valid = payload_valid;
+  frame->payload_size = 0;
+  frame->payload = NULL;
+  if(header_valid && payload_valid && (payload_size > 0))
+  {
+    frame->payload = malloc(payload_size);
+    if(frame->payload == NULL)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      exit(EXIT_FAILURE);
+    }
+    memcpy(frame->payload, payload, payload_size);
+    frame->payload_size = payload_size;
+  }
+  frame->stats = stats;
+  frame->stats.framesyms = NULL;
+  frame->stats.num_framesyms = 0;
+  frame->next = NULL;
+
+  if(chunk->last_frame)
+  {
+    chunk->last_frame->next = frame;
+  }
+  else
+  {
+    chunk->frames = frame;
+  }
+  chunk->last_frame = frame;
+
+  return(0);
+}
+
+void decode_chunk(struct parallel_decoder_s *decoder,
+                  struct chunk_s *chunk,
+                  struct receiver_s *receiver,
+                  complex float *samples,
+                  complex float *frame_samples)
+{
+  dsss_transfer_t transfer = decoder->transfer;
+  unsigned long long int position;
+  void *input = samples;
+  size_t size;
+  ssize_t r;
+  unsigned int n;
+
+  position = (chunk->start > decoder->overlap) ?
+    chunk->start - decoder->overlap :
+    0;
+  while((position < chunk->end) && !is_stopped(transfer))
+  {
+    n = MIN(receiver->samples_size, chunk->end - position);
+    if(transfer->mapped_file)
+    {
+      /* No copy, see receive_samples() */
+      size = (size_t) n * transfer->sample_size;
+      input = (void *) mapped_file_get(transfer->mapped_file,
+                                       position * transfer->sample_size,
+                                       &size);
+      r = size;
+    }
+    else
+    {
+      r = pread(decoder->fd,
+                samples,
+                n * transfer->sample_size,
+                position * transfer->sample_size);
+    }
+    if(r <= 0)
+    {
+      break;
+    }
+    n = r / transfer->sample_size;
+    position += n;
+    chunk->position = position;
+    if(position > chunk->start)
+    {
+      /* The samples of the overlap are counted by the previous chunk */
+      count_stat(transfer,
+                 &transfer->stats.samples,
+                 position - MAX(position - n, chunk->start));
+    }
+    n = downconvert_samples(receiver, input, n, frame_samples);
+    synchronize_samples(receiver, frame_samples, n);
+    if(position <= chunk->start)
+    {
+      /* Same for the frames skipped in the overlap */
+      receiver->filtered_frames =
+        dsssframesync_get_num_filtered(receiver->frame_synchronizer);
+    }
+  }
+
+  if((chunk == &decoder->chunks[decoder->chunks_count - 1]) &&
+     (position == chunk->end))
+  {
+    /* End of the recording, get the frames still in the filter and
+     * synchronizer delays, like receive_frames() */
+    n = flush_samples(receiver, samples, frame_samples);
+    synchronize_samples(receiver, frame_samples, n);
+    flush_frame_synchronizer(receiver);
+  }
+}
+
+void * parallel_decoder_worker(void *arg)
+{
+  struct parallel_decoder_s *decoder = (struct parallel_decoder_s *) arg;
+  struct receiver_s receiver;
+  struct chunk_s *chunk;
+  complex float *samples = NULL;
+  complex float *frame_samples = NULL;
+
+  while(1)
+  {
+    pthread_mutex_lock(&decoder->mutex);
+    if(decoder->next_chunk < decoder->chunks_count)
+    {
+      chunk = &decoder->chunks[decoder->next_chunk];
+      decoder->next_chunk++;
+    }
+    else
+    {
+      chunk = NULL;
+    }
+    pthread_mutex_unlock(&decoder->mutex);
+    if(chunk == NULL)
+    {
+      break;
+    }
+
+    /* Each chunk is decoded from a clean state */
+    receiver_init(&receiver, decoder->transfer, chunk_frame_received, chunk);
+    if(samples == NULL)
+    {
+      samples = malloc((receiver.samples_size + receiver.delay) *
+                       sizeof(complex float));
+      frame_samples = malloc((receiver.frame_samples_size + receiver.delay) *
+                             sizeof(complex float));
+      if((samples == NULL) || (frame_samples == NULL))
+      {
+        fprintf(stderr, _("Error: Memory allocation failed\n"));
+        exit(EXIT_FAILURE);
+      }
+    }
+    decode_chunk(decoder, chunk, &receiver, samples, frame_samples);
+    receiver_free(&receiver);
+
+    pthread_mutex_lock(&decoder->mutex);
+    chunk->done = 1;
+    pthread_cond_broadcast(&decoder->cond);
+    pthread_mutex_unlock(&decoder->mutex);
+  }
+
+  free(frame_samples);
+  free(samples);
+
+  return(NULL);
+}
+
+/* Merge two lists of frames sorted by position */
+struct decoded_frame_s * merge_decoded_frames(struct decoded_frame_s *a,
+                                              struct decoded_frame_s *b)
+{
+  struct decoded_frame_s head;
+  struct decoded_frame_s *last = &head;
+
+  while(a && b)
+  {
+    if(a->position <= b->position)
+    {
+      last->next = a;
+      a = a->next;
+    }
+    else
+    {
+      last->next = b;
+      b = b->next;
+    }
+    last = last->next;
+  }
+  last->next = a ? a : b;
+
+  return(head.next);
+}
+
+/* Decode a recording by splitting it in overlapping chunks decoded in
+ * parallel, and pass the frames to the callback in order. A frame found in
+ * the overlap between two chunks is decoded twice; the copy having the same
+ * id and counter as a frame already delivered just before is dropped. */
+void receive_frames_parallel(dsss_transfer_t transfer)
+{
+  struct parallel_decoder_s decoder;
+  struct receiver_s receiver;
+  unsigned int threads_count = transfer->decoding_threads;
+  pthread_t threads[threads_count];
+  struct stat file_stat;
+  unsigned long long int samples_count;
+  unsigned long long int chunk_size;
+  unsigned long long int block_size;
+  struct decoded_frame_s *pending = NULL;
+  struct decoded_frame_s *frame;
+  struct decoded_frame_s *delivered[16];
+  unsigned int delivered_count = 0;
+  unsigned long long int limit;
+  unsigned int duplicates = 0;
+  unsigned int i;
+  unsigned int j;
+  int duplicate;
+
+  decoder.transfer = transfer;
+  decoder.fd = fileno(transfer->radio_device.file);
+  if((fstat(decoder.fd, &file_stat) != 0) || !S_ISREG(file_stat.st_mode))
+  {
+    fprintf(stderr, _("Error: Parallel decoding requires a regular file\n"));
+    return;
+  }
+  samples_count = file_stat.st_size / transfer->sample_size;
+
+  /* Get the block size used by the workers */
+  receiver_init(&receiver, transfer, frame_received, transfer);
+  block_size = receiver.samples_size;
+  receiver_free(&receiver);
+
+  decoder.overlap = get_max_frame_samples(transfer) + 2 * block_size;
+  /* Make the chunks big enough for the overlap to cost little, but small
+   * enough to give some work to all the threads */
+  chunk_size = MAX(16 * decoder.overlap, 64 * block_size);
+  chunk_size = MIN(chunk_size, (samples_count + threads_count - 1) / threads_count);
+  chunk_size = MAX(chunk_size, block_size);
+  decoder.chunks_count = (samples_count + chunk_size - 1) / chunk_size;
+  decoder.chunks = calloc(MAX(decoder.chunks_count, 1), sizeof(struct chunk_s));
+  if(decoder.chunks == NULL)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < decoder.chunks_count; i++)
+  {
+    decoder.chunks[i].start = i * chunk_size;
+    decoder.chunks[i].end = MIN((i + 1) * chunk_size, samples_count);
+  }
+  decoder.next_chunk = 0;
+  pthread_mutex_init(&decoder.mutex, NULL);
+  pthread_cond_init(&decoder.cond, NULL);
+
+  if(transfer->verbose)
+  {
+    fprintf(stderr,
+            _("Info: Decoding %u chunks of %llu samples with %u threads\n"),
+            decoder.chunks_count,
+            chunk_size,
+            threads_count);
+  }
+
+  for(i = 0; i < threads_count; i++)
+  {
+    if(pthread_create(&threads[i], NULL, parallel_decoder_worker, &decoder) != 0)
+    {
+      fprintf(stderr, _("Error: Failed to start decoding threads\n"));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for(i = 0; i < decoder.chunks_count; i++)
+  {
+    pthread_mutex_lock(&decoder.mutex);
+    while(!decoder.chunks[i].done)
+    {
+      pthread_cond_wait(&decoder.cond, &decoder.mutex);
+    }
+    pthread_mutex_unlock(&decoder.mutex);
+
+    /* The frames of the next chunk can't be before 'limit', so everything
+     * before it can be delivered */
+    pending = merge_decoded_frames(pending, decoder.chunks[i].frames);
+    decoder.chunks[i].frames = NULL;
+    if(i + 1 < decoder.chunks_count)
+    {
+      limit = (decoder.chunks[i + 1].start > decoder.overlap) ?
+        decoder.chunks[i + 1].start - decoder.overlap :
+        0;
+    }
+    else
+    {
+      limit = samples_count + 1;
+    }
+
+    while(pending && (pending->position < limit))
+    {
+      frame = pending;
+      pending = frame->next;
+      frame->next = NULL;
+
+      duplicate = 0;
+      if(frame->header_valid && frame->payload_valid)
+      {
+        for(j = 0; j < delivered_count; j++)
+        {
+          if((memcmp(delivered[j]->header, frame->header, 8) == 0) &&
+             (frame->position - delivered[j]->position <= 2 * block_size))
+          {
+            duplicate = 1;
+            break;
+          }
+        }
+      }
+      if(duplicate)
+      {
+        duplicates++;
+        free_decoded_frames(frame);
+        continue;
+      }
+
+      frame_received(frame->header,
+                     frame->header_valid,
+                     frame->payload,
+                     frame->payload_size,
+                     frame->payload_valid,
+                     frame->stats,
+                     transfer);
+      if(frame->header_valid && frame->payload_valid)
+      {
+        /* Remember the last delivered frames for duplicate detection */
+        if(delivered_count == 16)
+        {
+          free_decoded_frames(delivered[0]);
+          memmove(delivered, delivered + 1, 15 * sizeof(struct decoded_frame_s *));
+          delivered_count--;
+        }
+        delivered[delivered_count] = frame;
+        delivered_count++;
+      }
+      else
+      {
+        free_decoded_frames(frame);
+      }
+    }
+  }
+
+  for(i = 0; i < threads_count; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  if(transfer->verbose)
+  {
+    fprintf(stderr, _("Info: %u duplicate frames dropped\n"), duplicates);
+  }
+
+  for(i = 0; i < delivered_count; i++)
+  {
+    free_decoded_frames(delivered[i]);
+  }
+  free_decoded_frames(pending);
+  for(i = 0; i < decoder.chunks_count; i++)
+  {
+    free_decoded_frames(decoder.chunks[i].frames);
+  }
+  free(decoder.chunks);
+  pthread_cond_destroy(&decoder.cond);
+  pthread_mutex_destroy(&decoder.mutex);
+}
+
+struct channel_s
+{
+  struct channelizer_s *channelizer;
+  /* Index of the output of the filterbank */
+  unsigned int index;
+  msresamp_crcf resampler;
+  unsigned int delay;
+  dsssframesync frame_synchronizer;
+  unsigned int routes_version;
+  unsigned int filtered_frames;
+  complex float *frame_samples;
+};
+
+struct channelizer_s
+{
+  dsss_transfer_t transfer;
+  firpfbch2_crcf filterbank;
+  unsigned int channels;
+  struct channel_s *active;
+  unsigned int active_size;
+  /* Samples of the active channels for two blocks: while the workers
+   * process one block, the next one is filled */
+  complex float *outputs[2];
+  unsigned int outputs_size[2];
+  unsigned int block_size;
+  unsigned long int generation;
+  unsigned int busy;
+  int finished;
+  unsigned int workers_count;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  /* The frames of all the channels are passed to the callbacks one at a
+   * time */
+  pthread_mutex_t delivery_mutex;
+};
+
+struct channel_worker_s
+{
+  struct channelizer_s *channelizer;
+  unsigned int number;
+};
+
+int channel_frame_received(unsigned char *header,
+                           int header_valid,
+                           unsigned char *payload,
+                           unsigned int payload_size,
+                           int payload_valid,
+                           framesyncstats_s stats,
+                           void *user_data)
+{
+  struct channel_s *channel = (struct channel_s *) user_data;
+  struct channelizer_s *channelizer = channel->channelizer;
+
+  pthread_mutex_lock(&channelizer->delivery_mutex);
+  if(channelizer->transfer->verbose && header_valid && payload_valid)
+  {
+    fprintf(stderr, _("Info: Frame in channel %u\n"), channel->index);
+  }
+  frame_received(header,
+                 header_valid,
+                 payload,
+                 payload_size,
+                 payload_valid,
+                 stats,
+                 channelizer->transfer);
+  pthread_mutex_unlock(&channelizer->delivery_mutex);
+
+  return(0);
+}
+
+/* Resample the samples of a channel and synchronize the frames */
+void process_channel(struct channel_s *channel,
+                     complex float *samples,
+                     unsigned int samples_size)
+{
+  unsigned int n;
+
+  msresamp_crcf_execute(channel->resampler,
+                        samples,
+                        samples_size,
+                        channel->frame_samples,
+                        &n);
+  update_id_filter(channel->channelizer->transfer,
+                   channel->frame_synchronizer,
+                   &channel->routes_version);
+  dsssframesync_execute_filtered(channel->frame_synchronizer,
+                                 channel->frame_samples,
+                                 n);
+  count_filtered_frames(channel->channelizer->transfer,
+                        channel->frame_synchronizer,
+                        &channel->filtered_frames);
+}
+
+void flush_channel(struct channel_s *channel)
+{
+  complex float zero_samples[channel->delay + 1];
+  complex float zero_sample = 0;
+  unsigned int n;
+
+  for(n = 0; n <= channel->delay; n++)
+  {
+    zero_samples[n] = 0;
+  }
+  process_channel(channel, zero_samples, channel->delay);
+  while(dsssframesync_is_frame_open(channel->frame_synchronizer))
+  {
+    dsssframesync_execute_filtered(channel->frame_synchronizer,
+                                   &zero_sample,
+                                   1);
+  }
+  count_filtered_frames(channel->channelizer->transfer,
+                        channel->frame_synchronizer,
+                        &channel->filtered_frames);
+}
+
+/* Process the channels 'number', 'number + workers_count', etc. of each
+ * block */
+void * channel_worker(void *arg)
+{
+  struct channel_worker_s *worker = (struct channel_worker_s *) arg;
+  struct channelizer_s *channelizer = worker->channelizer;
+  unsigned long int generation = 0;
+  complex float *outputs;
+  unsigned int size;
+  unsigned int i;
+
+  while(1)
+  {
+    pthread_mutex_lock(&channelizer->mutex);
+    while((channelizer->generation == generation) && !channelizer->finished)
+    {
+      pthread_cond_wait(&channelizer->cond, &channelizer->mutex);
+    }
+    if(channelizer->generation == generation)
+    {
+      pthread_mutex_unlock(&channelizer->mutex);
+      break;
+    }
+    generation = channelizer->generation;
+    outputs = channelizer->outputs[generation % 2];
+    size = channelizer->outputs_size[generation % 2];
+    pthread_mutex_unlock(&channelizer->mutex);
+
+    for(i = worker->number; i < channelizer->active_size; i += channelizer->workers_count)
+    {
+      process_channel(&channelizer->active[i],
+                      outputs + i * channelizer->block_size,
+                      size);
+    }
+
+    pthread_mutex_lock(&channelizer->mutex);
+    channelizer->busy--;
+    pthread_cond_broadcast(&channelizer->cond);
+    pthread_mutex_unlock(&channelizer->mutex);
+  }
+
+  for(i = worker->number; i < channelizer->active_size; i += channelizer->workers_count)
+  {
+    flush_channel(&channelizer->active[i]);
+  }
+
+  return(NULL);
+}
+
+/* Give a block of channelized samples to the workers, after they have
+ * finished processing the previous one */
+void publish_channels(struct channelizer_s *channelizer)
+{
+  pthread_mutex_lock(&channelizer->mutex);
+  while(channelizer->busy > 0)
+  {
+    pthread_cond_wait(&channelizer->cond, &channelizer->mutex);
+  }
+  channelizer->generation++;
+  channelizer->busy = channelizer->workers_count;
+  pthread_cond_broadcast(&channelizer->cond);
+  pthread_mutex_unlock(&channelizer->mutex);
+}
+
+/* Split the complete steps of 'input' into the buffer of the active
+ * channels that is not used by the workers, and keep the remaining samples
+ * at the start of 'input' */
+void channelize_samples(struct channelizer_s *channelizer,
+                        complex float *input,
+                        unsigned int *input_size)
+{
+  unsigned int step = channelizer->channels / 2;
+  complex float filterbank_output[channelizer->channels];
+  unsigned int buffer = (channelizer->generation + 1) % 2;
+  unsigned int j;
+  unsigned int k;
+
+  for(k = 0; (k + 1) * step <= *input_size; k++)
+  {
+    firpfbch2_crcf_execute(channelizer->filterbank,
+                           input + k * step,
+                           filterbank_output);
+    for(j = 0; j < channelizer->active_size; j++)
+    {
+      channelizer->outputs[buffer][j * channelizer->block_size + k] =
+        filterbank_output[channelizer->active[j].index];
+    }
+  }
+  channelizer->outputs_size[buffer] = k;
+  memmove(input, input + k * step, (*input_size - k * step) * sizeof(complex float));
+  *input_size -= k * step;
+}
+
+/* Semi-length of the filters of the filterbank, in steps of the input. The
+ * delay of the filterbank is about twice this. */
+#define FILTERBANK_SEMI_LENGTH 4
+
+/* Receive several channels: the band of the radio is split by a polyphase
+ * filterbank into 'channels' sub-bands overlapping by half, and the active
+ * sub-bands are resampled and synchronized by a pool of worker threads. */
+void receive_frames_channelized(dsss_transfer_t transfer)
+{
+  struct channelizer_s channelizer;
+  unsigned int workers_count = MAX(1, transfer->decoding_threads);
+  struct channel_worker_s workers[workers_count];
+  pthread_t threads[workers_count];
+  /* The filterbank takes 'channels / 2' samples at once and produces one
+   * sample for each channel */
+  unsigned int step = transfer->channels / 2;
+  float channel_rate = (float) transfer->sample_rate / step;
+  float resampling_ratio = (transfer->bit_rate *
+                            transfer->spreading_factor * 2) / channel_rate;
+  unsigned int samples_size;
+  void *samples;
+  complex float *input;
+  unsigned int input_size = 0;
+  unsigned int frame_samples_size;
+  unsigned int i;
+  int r;
+
+  channelizer.transfer = transfer;
+  channelizer.channels = transfer->channels;
+  channelizer.active_size = transfer->active_channels_size;
+  channelizer.workers_count = workers_count;
+  channelizer.generation = 0;
+  channelizer.busy = 0;
+  channelizer.finished = 0;
+  /* Process data by blocks of 'block_duration' (50 ms by default) */
+  channelizer.block_size = ceilf((channel_rate *
+                                  transfer->block_duration) / 1000.0);
+  samples_size = channelizer.block_size * step;
+  frame_samples_size = ceilf(channelizer.block_size * resampling_ratio);
+  channelizer.filterbank = firpfbch2_crcf_create_kaiser(LIQUID_ANALYZER,
+                                                        transfer->channels,
+                                                        FILTERBANK_SEMI_LENGTH,
+                                                        60);
+  channelizer.active = calloc(channelizer.active_size, sizeof(struct channel_s));
+  samples = malloc(samples_size * transfer->sample_size);
+  input = malloc((samples_size + step) * sizeof(complex float));
+  for(i = 0; i < 2; i++)
+  {
+    channelizer.outputs[i] = malloc(channelizer.active_size *
+                                    channelizer.block_size *
+                                    sizeof(complex float));
+    channelizer.outputs_size[i] = 0;
+  }
+  if((channelizer.active == NULL) || (samples == NULL) || (input == NULL) ||
+     (channelizer.outputs[0] == NULL) || (channelizer.outputs[1] == NULL))
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < channelizer.active_size; i++)
+  {
+    channelizer.active[i].channelizer = &channelizer;
+    channelizer.active[i].index = transfer->active_channels[i];
+    channelizer.active[i].resampler = msresamp_crcf_create(resampling_ratio, 60);
+    channelizer.active[i].delay = ceilf(msresamp_crcf_get_delay(channelizer.active[i].resampler));
+    channelizer.active[i].filtered_frames = 0;
+    channelizer.active[i].routes_version = atomic_load(&transfer->routes_version);
+    channelizer.active[i].frame_synchronizer = create_frame_synchronizer(transfer,
+                                                                         channel_frame_received,
+                                                                         &channelizer.active[i]);
+    channelizer.active[i].frame_samples = malloc((frame_samples_size +
+                                                  channelizer.active[i].delay) *
+                                                 sizeof(complex float));
+    if(channelizer.active[i].frame_samples == NULL)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      exit(EXIT_FAILURE);
+    }
+  }
+  pthread_mutex_init(&channelizer.mutex, NULL);
+  pthread_cond_init(&channelizer.cond, NULL);
+  pthread_mutex_init(&channelizer.delivery_mutex, NULL);
+
+  if(transfer->verbose)
+  {
+    fprintf(stderr,
+            _("Info: %u channels of %.0f Hz, %u active, %u threads\n"),
+            transfer->channels,
+            (float) transfer->sample_rate / transfer->channels,
+            channelizer.active_size,
+            workers_count);
+  }
+
+  for(i = 0; i < workers_count; i++)
+  {
+    workers[i].channelizer = &channelizer;
+    workers[i].number = i;
+    if(pthread_create(&threads[i], NULL, channel_worker, &workers[i]) != 0)
+    {
+      fprintf(stderr, _("Error: Failed to start decoding threads\n"));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  while(!is_stopped(transfer))
+  {
+    r = read_samples(transfer, samples, samples_size - input_size);
+    if(r < 0)
+    {
+      break;
+    }
+    /* The frequency offset is only used to tune the radio, the filterbank
+     * does the frequency shifts */
+    TIMING_START(start);
+    kernel_convert_mix_down(transfer->sample_format,
+                            samples,
+                            input + input_size,
+                            r,
+                            NULL);
+    input_size += r;
+    channelize_samples(&channelizer, input, &input_size);
+    TIMING_STOP(transfer->timing, TIMING_FRONTEND, start);
+    publish_channels(&channelizer);
+  }
+
+  if(!is_stopped(transfer))
+  {
+    /* End of the stream: push the last samples out of the filterbank with
+     * zeros. The workers then flush the resampler and the frame
+     * synchronizer of each channel with flush_channel(). */
+    r = MIN(samples_size, input_size + (2 * FILTERBANK_SEMI_LENGTH + 1) * step);
+    for(i = input_size; i < (unsigned int) r; i++)
+    {
+      input[i] = 0;
+    }
+    input_size = r;
+    channelize_samples(&channelizer, input, &input_size);
+    publish_channels(&channelizer);
+  }
+
+  pthread_mutex_lock(&channelizer.mutex);
+  channelizer.finished = 1;
+  pthread_cond_broadcast(&channelizer.cond);
+  pthread_mutex_unlock(&channelizer.mutex);
+  for(i = 0; i < workers_count; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  for(i = 0; i < channelizer.active_size; i++)
+  {
+    free(channelizer.active[i].frame_samples);
+    dsssframesync_destroy(channelizer.active[i].frame_synchronizer);
+    msresamp_crcf_destroy(channelizer.active[i].resampler);
+  }
+  pthread_mutex_destroy(&channelizer.delivery_mutex);
+  pthread_cond_destroy(&channelizer.cond);
+  pthread_mutex_destroy(&channelizer.mutex);
+  free(channelizer.outputs[0]);
+  free(channelizer.outputs[1]);
+  free(input);
+  free(samples);
+  free(channelizer.active);
+  firpfbch2_crcf_destroy(channelizer.filterbank);
+}
+
+void print_filtered_frames(struct receiver_s *receiver)
+{
+  unsigned int n = dsssframesync_get_num_filtered(receiver->frame_synchronizer);
+
+  if(receiver->transfer->verbose && (n > 0))
+  {
+    fprintf(stderr, _("Info: %u frames for other ids skipped\n"), n);
+  }
+}
+
+void receive_frames(dsss_transfer_t transfer)
+{
+  struct receiver_s receiver;
+  int r;
+  unsigned int n;
+  complex float *frame_samples;
+  complex float *samples;
+  void *input;
+
+  if(transfer->channels > 0)
+  {
+    receive_frames_channelized(transfer);
+    return;
+  }
+
+  if((transfer->decoding_threads > 1) &&
+     (transfer->radio_type == FILENAME) &&
+     (transfer->audio_converter == NULL))
+  {
+    receive_frames_parallel(transfer);
+    return;
+  }
+
+  receiver_init(&receiver, transfer, frame_received, transfer);
+
+  if(transfer->pipeline > 0)
+  {
+    if(receive_frames_pipelined(&receiver))
+    {
+      print_filtered_frames(&receiver);
+      print_squelch_stats(&receiver);
+      receiver_free(&receiver);
+      return;
+    }
+    fprintf(stderr,
+            _("Error: Failed to start the receive pipeline, using a single thread\n"));
+  }
+
+  frame_samples = malloc((receiver.frame_samples_size + receiver.delay) *
+                         sizeof(complex float));
+  samples = malloc((receiver.samples_size + receiver.delay) *
+                   sizeof(complex float));
+  if((frame_samples == NULL) || (samples == NULL))
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
+  }
+
+  while(!is_stopped(transfer))
+  {
+    r = receive_samples(&receiver, samples, &input);
+    if(r < 0)
+    {
+      break;
+    }
+    n = downconvert_samples(&receiver, input, r, frame_samples);
+    synchronize_samples(&receiver, frame_samples, n);
+  }
+
+  n = flush_samples(&receiver, samples, frame_samples);
+  synchronize_samples(&receiver, frame_samples, n);
+  flush_frame_synchronizer(&receiver);
+  print_filtered_frames(&receiver);
+  print_squelch_stats(&receiver);
+
+  free(samples);
+  free(frame_samples);
+  receiver_free(&receiver);
+}
+
+dsss_transfer_t dsss_transfer_create_callback(char *radio_driver,
+                                              unsigned char emit,
+                                              int (*data_callback)(void *,
+                                                                   unsigned char *,
+                                                                   unsigned int),
+                                              void *callback_context,
+                                              unsigned long int sample_rate,
+                                              unsigned int bit_rate,
+                                              unsigned long int frequency,
+                                              long int frequency_offset,
+                                              char *gain,
+                                              float ppm,
+                                              unsigned int spreading_factor,
+                                              char *inner_fec,
+                                              char *outer_fec,
+                                              char *id,
+                                              char *dump,
+                                              unsigned int timeout,
+                                              unsigned char audio)
+{
+  int direction;
+  SoapySDRKwargs kwargs;
+  unsigned int n;
+  char *gain_name;
+  int gain_value;
+  dsss_transfer_t transfer = malloc(sizeof(struct dsss_transfer_s));
+
+  if(transfer == NULL)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    return(NULL);
+  }
+  bzero(transfer, sizeof(struct dsss_transfer_s));
+  kernels_init();
+  transfer->verbose = atomic_load(&default_verbose);
+  transfer->block_duration = 50;
+  transfer->frame_duration = 100;
+  transfer->input_timeout = transfer->block_duration;
+  pthread_mutex_init(&transfer->routes_mutex, NULL);
+  atomic_init(&transfer->routes_version, 0);
+  pthread_mutex_init(&transfer->stats_mutex, NULL);
+#ifdef ENABLE_TIMING
+  transfer->timing = timing_create();
+  if(transfer->timing == NULL)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    pthread_mutex_destroy(&transfer->stats_mutex);
+    pthread_mutex_destroy(&transfer->routes_mutex);
+    free(transfer);
+    return(NULL);
+  }
+#endif
+
+  if(strcasecmp(radio_driver, "io") == 0)
+  {
+    transfer->radio_type = IO;
+  }
+  else if(strncasecmp(radio_driver, "file=", 5) == 0)
+  {
+    transfer->radio_type = FILENAME;
+  }
+  else if(strncasecmp(radio_driver, "loopback=", 9) == 0)
+  {
+    transfer->radio_type = LOOPBACK;
+  }
+  else
+  {
+    transfer->radio_type = SOAPYSDR;
+  }
+
+  atomic_init(&transfer->stop, 0);
+  transfer->emit = emit;
+  transfer->sample_format = SAMPLE_FORMAT_CF32;
+  transfer->sample_size = sample_format_size(transfer->sample_format);
+  transfer->file = NULL;
+  transfer->data_callback = data_callback;
+  transfer->callback_context = callback_context;
+
+  if(sample_rate != 0)
+  {
+    transfer->sample_rate = sample_rate * ((1000000.0 - ppm) / 1000000.0);
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid sample rate\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  if(frequency != 0)
+  {
+    transfer->frequency = frequency * ((1000000.0 - ppm) / 1000000.0);
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid frequency\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  transfer->frequency_offset = frequency_offset;
+
+  if(audio)
+  {
+    if((transfer->radio_type == IO) || (transfer->radio_type == FILENAME))
+    {
+      transfer->audio_converter = firhilbf_create(25, 60);
+      transfer->direct_audio = 0;
+      transfer->audio_sample_rate = transfer->sample_rate;
+      transfer->audio_frequency = transfer->frequency;
+      /* The rate of audio samples is twice the rate of IQ samples */
+      transfer->sample_rate = transfer->sample_rate / 2;
+      /* -(sample_rate / 2) Hz IQ <=> 0 Hz audio
+       * (sample_rate / 2) Hz IQ <=> (sample_rate * 2) Hz audio */
+      transfer->frequency_offset = transfer->frequency - (transfer->sample_rate / 2);
+      transfer->frequency = 0;
+      gain_value = strtol(gain, NULL, 10);
+      transfer->audio_gain = powf(10, gain_value / 20.0);
+      transfer->audio_format = SAMPLE_FORMAT_CS16;
+    }
+    else
+    {
+      fprintf(stderr, _("Error: This radio type only supports IQ samples\n"));
+      free(transfer);
+      return(NULL);
+    }
+  }
+  else
+  {
+    transfer->audio_converter = NULL;
+    transfer->audio_gain = 0;
+  }
+
+  if(bit_rate != 0)
+  {
+    transfer->bit_rate = bit_rate;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid bit rate\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  if(spreading_factor >= 2)
+  {
+    transfer->spreading_factor = spreading_factor;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid spreading factor\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  transfer->crc = LIQUID_CRC_32;
+
+  transfer->inner_fec = liquid_getopt_str2fec(inner_fec);
+  if(transfer->inner_fec == LIQUID_FEC_UNKNOWN)
+  {
+    fprintf(stderr, _("Error: Invalid inner FEC\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  transfer->outer_fec = liquid_getopt_str2fec(outer_fec);
+  if(transfer->outer_fec == LIQUID_FEC_UNKNOWN)
+  {
+    fprintf(stderr, _("Error: Invalid outer FEC\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  if(strlen(id) <= 4)
+  {
+    strcpy(transfer->id, id);
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Id must be at most 4 bytes long\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  if(dump)
+  {
+    transfer->dump = fopen(dump, "wb");
+    if(transfer->dump == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), dump);
+      free(transfer);
+      return(NULL);
+    }
+  }
+  else
+  {
+    transfer->dump = NULL;
+  }
+
+  transfer->timeout = timeout;
+
+  switch(transfer->radio_type)
+  {
+  case IO:
+    break;
+
+  case FILENAME:
+    if(emit)
+    {
+      transfer->radio_device.file = fopen(radio_driver + 5, "wb");
+    }
+    else
+    {
+      transfer->radio_device.file = fopen(radio_driver + 5, "rb");
+    }
+    if(transfer->radio_device.file == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), radio_driver + 5);
+      free(transfer);
+      return(NULL);
+    }
+    if(!emit && (transfer->audio_converter == NULL))
+    {
+      /* Use the samples of the recording without copying them. If the
+       * file can't be mapped (not a regular file), it is read normally. */
+      transfer->mapped_file = mapped_file_create(fileno(transfer->radio_device.file));
+    }
+    break;
+
+  case LOOPBACK:
+    transfer->radio_device.loopback = loopback_open(radio_driver + 9, emit);
+    if(transfer->radio_device.loopback == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), radio_driver + 9);
+      free(transfer);
+      return(NULL);
+    }
+    break;
+
+  case SOAPYSDR:
+    transfer->radio_device.soapysdr = SoapySDRDevice_makeStrArgs(radio_driver);
+    if(transfer->radio_device.soapysdr == NULL)
+    {
+      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
+      free(transfer);
+      return(NULL);
+    }
+    direction = emit ? SOAPY_SDR_TX : SOAPY_SDR_RX;
+    SOAPYSDR_CHECK(SoapySDRDevice_setSampleRate(transfer->radio_device.soapysdr,
+                                                direction,
+                                                0,
+                                                transfer->sample_rate));
+    SOAPYSDR_CHECK(SoapySDRDevice_setFrequency(transfer->radio_device.soapysdr,
+                                               direction,
+                                               0,
+                                               transfer->frequency - transfer->frequency_offset,
+                                               NULL));
+    if(strchr(gain, '='))
+    {
+      kwargs = SoapySDRKwargs_fromString(gain);
+      for(n = 0; n < kwargs.size; n++)
+      {
+        gain_name = kwargs.keys[n];
+        gain_value = strtoul(kwargs.vals[n], NULL, 10);
+        SOAPYSDR_CHECK(SoapySDRDevice_setGainElement(transfer->radio_device.soapysdr,
+                                                     direction,
+                                                     0,
+                                                     gain_name,
+                                                     gain_value));
+      }
+      SoapySDRKwargs_clear(&kwargs);
+    }
+    else
+    {
+      gain_value = strtoul(gain, NULL, 10);
+      SOAPYSDR_CHECK(SoapySDRDevice_setGain(transfer->radio_device.soapysdr,
+                                            direction,
+                                            0,
+                                            gain_value));
+    }
+    transfer->radio_stream.soapysdr = SoapySDRDevice_setupStream(transfer->radio_device.soapysdr,
+                                                                 direction,
+                                                                 SOAPY_SDR_CF32,
+                                                                 NULL,
+                                                                 0,
+                                                                 NULL);
+    if(transfer->radio_stream.soapysdr == NULL)
+    {
+      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
+      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
+      free(transfer);
+      return(NULL);
+    }
+    break;
+
+  default:
+    fprintf(stderr, _("Error: Unknown radio type\n"));
+    free(transfer);
+    return(NULL);
+    break;
+  }
+
+  return(transfer);
+}
+
+dsss_transfer_t dsss_transfer_create(char *radio_driver,
+                                     unsigned char emit,
+                                     char *file,
+                                     unsigned long int sample_rate,
+                                     unsigned int bit_rate,
+                                     unsigned long int frequency,
+                                     long int frequency_offset,
+                                     char *gain,
+                                     float ppm,
+                                     unsigned int spreading_factor,
+                                     char *inner_fec,
+                                     char *outer_fec,
+                                     char *id,
+                                     char *dump,
+                                     unsigned int timeout,
+                                     unsigned char audio)
+{
+  dsss_transfer_t transfer;
+
+  transfer = dsss_transfer_create_callback(radio_driver,
+                                           emit,
+                                           emit ? read_data : write_data,
+                                           NULL,
+                                           sample_rate,
+                                           bit_rate,
+                                           frequency,
+                                           frequency_offset,
+                                           gain,
+                                           ppm,
+                                           spreading_factor,
+                                           inner_fec,
+                                           outer_fec,
+                                           id,
+                                           dump,
+                                           timeout,
+                                           audio);
+  if(transfer == NULL)
+  {
+    return(NULL);
+  }
+
+  transfer->callback_context = transfer;
+  if(file)
+  {
+    if(emit)
+    {
+      transfer->file = fopen(file, "rb");
+    }
+    else
+    {
+      transfer->file = fopen(file, "wb");
+    }
+    if(transfer->file == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), file);
+      free(transfer);
+      return(NULL);
+    }
+  }
+  else
+  {
+    if(emit)
+    {
+      transfer->file = stdin;
+    }
+    else
+    {
+      transfer->file = stdout;
+    }
+  }
+
+  return(transfer);
+}
+
+void dsss_transfer_free(dsss_transfer_t transfer)
+{
+  if(transfer)
+  {
+    if(transfer->file)
+    {
+      fclose(transfer->file);
+    }
+    if(transfer->dump)
+    {
+      fclose(transfer->dump);
+    }
+    free(transfer->recorder_filename);
+    if(transfer->audio_converter)
+    {
+      firhilbf_destroy(transfer->audio_converter);
+    }
+    switch(transfer->radio_type)
+    {
+    case IO:
+      break;
+
+    case FILENAME:
+      mapped_file_free(transfer->mapped_file);
+      fclose(transfer->radio_device.file);
+      break;
+
+    case LOOPBACK:
+      loopback_release(transfer->radio_device.loopback);
+      break;
+
+    case SOAPYSDR:
+      if(transfer->radio_stream.soapysdr)
+      {
+        SoapySDRDevice_deactivateStream(transfer->radio_device.soapysdr,
+                                        transfer->radio_stream.soapysdr,
+                                        0,
+                                        0);
+        SoapySDRDevice_closeStream(transfer->radio_device.soapysdr,
+                                   transfer->radio_stream.soapysdr);
+      }
+      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
+      break;
+
+    default:
+      break;
+    }
+    free(transfer->active_channels);
+    free(transfer->routes);
+    pthread_mutex_destroy(&transfer->routes_mutex);
+    pthread_mutex_destroy(&transfer->stats_mutex);
+    timing_free(transfer->timing);
+    // Set pointers to NULL to avoid double-free if free is called again or checked.
+    transfer->radio_device.soapysdr = NULL; 
+    transfer->radio_stream.soapysdr = NULL;
+    
+    free(transfer);
+  }
+}
+
+void print_timing(dsss_transfer_t transfer)
+{
+  dsss_transfer_timing_t timings[TIMING_STAGES];
+  unsigned int n;
+  unsigned int i;
+  float margin;
+
+  n = dsss_transfer_get_timing(transfer, timings, TIMING_STAGES, &margin);
+  for(i = 0; i < n; i++)
+  {
+    if(timings[i].count == 0)
+    {
+      continue;
+    }
+    fprintf(stderr,
+            _("Info: Timing of %s: %llu calls, mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n"),
+            timings[i].name,
+            timings[i].count,
+            timings[i].mean * 1e6,
+            timings[i].p50 * 1e6,
+            timings[i].p99 * 1e6,
+            timings[i].max * 1e6);
+  }
+  fprintf(stderr, _("Info: Real-time margin: %.1f%%\n"), 100 * margin);
+}
+
+void start_delivery(dsss_transfer_t transfer)
+{
+  delivery_t delivery;
+
+  if(transfer->delivery_size == 0)
+  {
+    return;
+  }
+  delivery = delivery_create(transfer->delivery_size, transfer->delivery_policy);
+  if(delivery == NULL)
+  {
+    fprintf(stderr, _("Error: Failed to start the delivery queue\n"));
+    return;
+  }
+  pthread_mutex_lock(&transfer->stats_mutex);
+  transfer->delivery = delivery;
+  pthread_mutex_unlock(&transfer->stats_mutex);
+}
+
+/* Wait until the queued payloads have been delivered, and keep the final
+ * counts of the queue in the statistics */
+void finish_delivery(dsss_transfer_t transfer)
+{
+  delivery_t delivery = transfer->delivery;
+
+  if(delivery == NULL)
+  {
+    return;
+  }
+  delivery_finish(delivery);
+  pthread_mutex_lock(&transfer->stats_mutex);
+  delivery_get_counts(delivery,
+                      &transfer->stats.queued_bytes,
+                      &transfer->stats.dropped_frames,
+                      &transfer->stats.dropped_bytes);
+  transfer->delivery = NULL;
+  pthread_mutex_unlock(&transfer->stats_mutex);
+  delivery_free(delivery);
+  if(transfer->verbose && (transfer->stats.dropped_frames > 0))
+  {
+    fprintf(stderr,
+            _("Info: Delivery queue full, %llu frames (%llu bytes) dropped\n"),
+            transfer->stats.dropped_frames,
+            transfer->stats.dropped_bytes);
+  }
+}
+
+/* Number of blocks of samples in the queue of the dump writer */
+#define DUMP_QUEUE_BLOCKS 20
+
+void start_dump(dsss_transfer_t transfer)
+{
+  sample_format_t format;
+  dump_t dump_writer;
+
+  if(transfer->dump == NULL)
+  {
+    return;
+  }
+  format = transfer->dump_format_set ?
+    transfer->dump_format :
+    transfer->sample_format;
+  /* Blocks of 'block_duration' of samples */
+  dump_writer = dump_create(transfer->dump,
+                            transfer->sample_format,
+                            format,
+                            MAX(1024,
+                                ceilf((transfer->sample_rate *
+                                       transfer->block_duration) / 1000.0)),
+                            DUMP_QUEUE_BLOCKS);
+  if(dump_writer == NULL)
+  {
+    fprintf(stderr, _("Error: Failed to start the dump writer\n"));
+    return;
+  }
+  pthread_mutex_lock(&transfer->stats_mutex);
+  transfer->dump_writer = dump_writer;
+  pthread_mutex_unlock(&transfer->stats_mutex);
+}
+
+/* Wait until the queued samples have been written, and keep the final
+ * counts of the writer in the statistics */
+void finish_dump(dsss_transfer_t transfer)
+{
+  dump_t dump_writer = transfer->dump_writer;
+
+  if(dump_writer == NULL)
+  {
+    return;
+  }
+  dump_finish(dump_writer);
+  pthread_mutex_lock(&transfer->stats_mutex);
+  dump_get_counts(dump_writer,
+                  &transfer->stats.dropped_dump_blocks,
+                  &transfer->stats.dropped_dump_samples);
+  transfer->dump_writer = NULL;
+  pthread_mutex_unlock(&transfer->stats_mutex);
+  dump_free(dump_writer);
+  if(transfer->verbose && (transfer->stats.dropped_dump_blocks > 0))
+  {
+    fprintf(stderr,
+            _("Info: Dump writer too slow, %llu blocks (%llu samples) dropped\n"),
+            transfer->stats.dropped_dump_blocks,
+            transfer->stats.dropped_dump_samples);
+  }
+}
+
+void start_recorder(dsss_transfer_t transfer)
+{
+  recorder_t recorder;
+
+  if(transfer->recorder_filename == NULL)
+  {
+    return;
+  }
+  recorder = recorder_create(transfer->recorder_filename,
+                             transfer->sample_size,
+                             ceilf(transfer->recorder_duration *
+                                   transfer->sample_rate));
+  if(recorder == NULL)
+  {
+    fprintf(stderr, _("Error: Failed to start the recorder\n"));
+    return;
+  }
+  transfer->recorder = recorder;
+}
+
+/* Write the last requested segment and stop the recorder */
+void finish_recorder(dsss_transfer_t transfer)
+{
+  recorder_t recorder = transfer->recorder;
+  unsigned long long int segments;
+  unsigned long long int missed;
+
+  if(recorder == NULL)
+  {
+    return;
+  }
+  recorder_finish(recorder);
+  recorder_get_counts(recorder, &segments, &missed);
+  transfer->recorder = NULL;
+  recorder_free(recorder);
+  if(transfer->verbose)
+  {
+    fprintf(stderr,
+            _("Info: Recorder: %llu segments written, %llu events missed\n"),
+            segments,
+            missed);
+  }
+}
+
+void dsss_transfer_start(dsss_transfer_t transfer)
+{
+  atomic_store(&transfer->stop, 0);
+  transfer->start_generation = atomic_load(&stop_generation);
+  if(!transfer->verbose_set)
+  {
+    transfer->verbose = atomic_load(&default_verbose);
+  }
+  if(transfer->verbose)
+  {
+    fprintf(stderr,
+            _("Info: Using %s kernels\n"),
+            kernels_get_name(kernels_get_selected()));
+  }
+
+  switch(transfer->radio_type)
+  {
+  case IO:
+    if(transfer->verbose)
+    {
+      fprintf(stderr, _("Info: Using IO pseudo-radio\n"));
+    }
+    break;
+
+  case FILENAME:
+    if(transfer->verbose)
+    {
+      fprintf(stderr, _("Info: Using FILENAME pseudo-radio\n"));
+      if(transfer->mapped_file)
+      {
+        fprintf(stderr, _("Info: Reading the samples from a memory mapping\n"));
+      }
+    }
+    break;
+
+  case LOOPBACK:
+    if(transfer->verbose)
+    {
+      fprintf(stderr, _("Info: Using LOOPBACK pseudo-radio\n"));
+    }
+    break;
+
+  case SOAPYSDR:
+    SoapySDRDevice_activateStream(transfer->radio_device.soapysdr,
+                                  transfer->radio_stream.soapysdr,
+                                  0,
+                                  0,
+                                  0);
+    break;
+
+  default:
+    return;
+  }
+
+  atomic_store(&transfer->timeout_start, time(NULL));
+  pthread_mutex_lock(&transfer->stats_mutex);
+  bzero(&transfer->stats, sizeof(dsss_transfer_stats_t));
+  transfer->evm_sum = 0;
+  transfer->rssi_sum = 0;
+  transfer->cfo_sum = 0;
+  transfer->measured_frames = 0;
+  pthread_mutex_unlock(&transfer->stats_mutex);
+  if(transfer->timing)
+  {
+    timing_reset(transfer->timing);
+  }
+  start_dump(transfer);
+  if(transfer->emit)
+  {
+    send_frames(transfer);
+  }
+  else
+  {
+    start_delivery(transfer);
+    start_recorder(transfer);
+    receive_frames(transfer);
+    finish_recorder(transfer);
+    finish_delivery(transfer);
+  }
+  finish_dump(transfer);
+  if(transfer->verbose && transfer->timing)
+  {
+    print_timing(transfer);
+  }
+}
+
+void dsss_transfer_stop(dsss_transfer_t transfer)
+{
+  atomic_store(&transfer->stop, 1);
+  if(transfer->radio_type == SOAPYSDR && transfer->radio_device.soapysdr && transfer->radio_stream.soapysdr)
+  {
+      SoapySDRDevice_deactivateStream(transfer->radio_device.soapysdr,
+                                      transfer->radio_stream.soapysdr,
+                                      0,
+                                      0);
+  }
+}
+
+void dsss_transfer_stop_all()
+{
+  atomic_fetch_add(&stop_generation, 1);
+}
+
+void dsss_transfer_set_verbosity(dsss_transfer_t transfer, unsigned char v)
+{
+  transfer->verbose = v;
+  transfer->verbose_set = 1;
+}
+
+int dsss_transfer_set_sample_format(dsss_transfer_t transfer, char *format)
+{
+  sample_format_t sample_format;
+  char *native_format = NULL;
+  double full_scale;
+  int direction = transfer->emit ? SOAPY_SDR_TX : SOAPY_SDR_RX;
+  SoapySDRStream *stream;
+
+  if(transfer->audio_converter != NULL)
+  {
+    /* The audio samples are converted to CF32 IQ samples */
+    if(strcasecmp(format, "F32") == 0)
+    {
+      transfer->audio_format = SAMPLE_FORMAT_CF32;
+    }
+    else if(strcasecmp(format, "S16") == 0)
+    {
+      transfer->audio_format = SAMPLE_FORMAT_CS16;
+    }
+    else
+    {
+      fprintf(stderr, _("Error: Audio samples can't use this sample format\n"));
+      return(-1);
+    }
+    if(transfer->verbose)
+    {
+      fprintf(stderr,
+              _("Info: Using %s audio samples\n"),
+              (transfer->audio_format == SAMPLE_FORMAT_CF32) ? "F32" : "S16");
+    }
+    return(0);
+  }
+
+  if((strcasecmp(format, "native") == 0) && (transfer->radio_type == SOAPYSDR))
+  {
+    native_format = SoapySDRDevice_getNativeStreamFormat(transfer->radio_device.soapysdr,
+                                                         direction,
+                                                         0,
+                                                         &full_scale);
+    /* Formats like CS12 are converted to CS16 by the driver */
+    format = ((native_format != NULL) &&
+              (strcasecmp(native_format, SOAPY_SDR_CS8) == 0)) ?
+      SOAPY_SDR_CS8 :
+      SOAPY_SDR_CS16;
+    free(native_format);
+  }
+  else if(strcasecmp(format, "native") == 0)
+  {
+    /* The other radios have no native format, the samples stay CF32 */
+    format = SOAPY_SDR_CF32;
+  }
+
+  if(strcasecmp(format, SOAPY_SDR_CF32) == 0)
+  {
+    sample_format = SAMPLE_FORMAT_CF32;
+  }
+  else if(strcasecmp(format, SOAPY_SDR_CS16) == 0)
+  {
+    sample_format = SAMPLE_FORMAT_CS16;
+  }
+  else if(strcasecmp(format, SOAPY_SDR_CS8) == 0)
+  {
+    sample_format = SAMPLE_FORMAT_CS8;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Unknown sample format '%s'\n"), format);
+    return(-1);
+  }
+
+  if((transfer->radio_type == SOAPYSDR) &&
+     (sample_format != transfer->sample_format))
+  {
+    /* Some drivers (e.g. HackRF) only allow one stream at a time, so the
+     * current stream is closed before setting up the new one */
+    SoapySDRDevice_closeStream(transfer->radio_device.soapysdr,
+                               transfer->radio_stream.soapysdr);
+    stream = SoapySDRDevice_setupStream(transfer->radio_device.soapysdr,
+                                        direction,
+                                        format,
+                                        NULL,
+                                        0,
+                                        NULL);
+    if(stream == NULL)
+    {
+      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
+      /* Keep a usable stream in the previous format */
+      format = (transfer->sample_format == SAMPLE_FORMAT_CS16) ?
+        SOAPY_SDR_CS16 :
+        (transfer->sample_format == SAMPLE_FORMAT_CS8) ?
+        SOAPY_SDR_CS8 :
+        SOAPY_SDR_CF32;
+      transfer->radio_stream.soapysdr = SoapySDRDevice_setupStream(transfer->radio_device.soapysdr,
+                                                                   direction,
+                                                                   format,
+                                                                   NULL,
+                                                                   0,
+                                                                   NULL);
+      return(-1);
+    }
+    transfer->radio_stream.soapysdr = stream;
+  }
+
+  transfer->sample_format = sample_format;
+  transfer->sample_size = sample_format_size(sample_format);
+  if(transfer->verbose)
+  {
+    fprintf(stderr, _("Info: Using %s samples\n"), format);
+  }
+
+  return(0);
+}
+
+int dsss_transfer_set_dump_format(dsss_transfer_t transfer, char *format)
+{
+  if(strcasecmp(format, SOAPY_SDR_CF32) == 0)
+  {
+    transfer->dump_format = SAMPLE_FORMAT_CF32;
+  }
+  else if(strcasecmp(format, SOAPY_SDR_CS16) == 0)
+  {
+    transfer->dump_format = SAMPLE_FORMAT_CS16;
+  }
+  else if(strcasecmp(format, SOAPY_SDR_CS8) == 0)
+  {
+    transfer->dump_format = SAMPLE_FORMAT_CS8;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Unknown sample format '%s'\n"), format);
+    return(-1);
+  }
+  transfer->dump_format_set = 1;
+  if(transfer->verbose)
+  {
+    fprintf(stderr, _("Info: Using %s samples for the dump\n"), format);
+  }
+
+  return(0);
+}
+
+/* Check whether receiving with 'threads' decoding threads uses the parallel
+ * decoder, which doesn't go through read_samples() */
+int is_parallel_decoding(dsss_transfer_t transfer, unsigned int threads)
+{
+  return((threads > 1) &&
+         !transfer->emit &&
+         (transfer->radio_type == FILENAME) &&
+         (transfer->audio_converter == NULL) &&
+         (transfer->channels == 0));
+}
+
+int dsss_transfer_set_recorder(dsss_transfer_t transfer,
+                               char *filename,
+                               float duration,
+                               char *events)
+{
+  unsigned int recorder_events;
+
+  if(filename == NULL)
+  {
+    free(transfer->recorder_filename);
+    transfer->recorder_filename = NULL;
+    return(0);
+  }
+  if(transfer->emit)
+  {
+    fprintf(stderr, _("Error: The recorder can only be used to receive\n"));
+    return(-1);
+  }
+  if(is_parallel_decoding(transfer, transfer->decoding_threads))
+  {
+    fprintf(stderr,
+            _("Error: The recorder can't be used with parallel decoding\n"));
+    return(-1);
+  }
+  /* Two memories of 'duration' seconds are allocated */
+  if((duration <= 0) || (duration * transfer->sample_rate > UINT_MAX))
+  {
+    fprintf(stderr, _("Error: Invalid recorder duration\n"));
+    return(-1);
+  }
+  if((events == NULL) || (strcasecmp(events, "errors") == 0))
+  {
+    recorder_events = RECORD_HEADER_ERRORS | RECORD_PAYLOAD_ERRORS;
+  }
+  else if(strcasecmp(events, "header") == 0)
+  {
+    recorder_events = RECORD_HEADER_ERRORS;
+  }
+  else if(strcasecmp(events, "payload") == 0)
+  {
+    recorder_events = RECORD_PAYLOAD_ERRORS;
+  }
+  else if(strcasecmp(events, "all") == 0)
+  {
+    recorder_events = RECORD_HEADER_ERRORS |
+      RECORD_PAYLOAD_ERRORS |
+      RECORD_VALID_FRAMES;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Unknown recorder events '%s'\n"), events);
+    return(-1);
+  }
+  free(transfer->recorder_filename);
+  transfer->recorder_filename = strdup(filename);
+  if(transfer->recorder_filename == NULL)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    return(-1);
+  }
+  transfer->recorder_duration = duration;
+  transfer->recorder_events = recorder_events;
+
+  return(0);
+}
+
+void dsss_transfer_set_pipeline(dsss_transfer_t transfer,
+                                unsigned int queue_duration)
+{
+  transfer->pipeline = queue_duration;
+}
+
+int dsss_transfer_set_durations(dsss_transfer_t transfer,
+                                unsigned int block_duration,
+                                unsigned int frame_duration)
+{
+  if(block_duration == 0)
+  {
+    block_duration = 50;
+  }
+  if(frame_duration == 0)
+  {
+    frame_duration = 100;
+  }
+  if((block_duration > MAX_BLOCK_DURATION) ||
+     (frame_duration > MAX_FRAME_DURATION))
+  {
+    fprintf(stderr, _("Error: Invalid block or frame duration\n"));
+    return(-1);
+  }
+
+  transfer->block_duration = block_duration;
+  transfer->frame_duration = frame_duration;
+  transfer->input_timeout = block_duration;
+
+  return(0);
+}
+
+int dsss_transfer_set_coalescing(dsss_transfer_t transfer,
+                                 unsigned int payload_size,
+                                 unsigned int max_wait)
+{
+  if(payload_size > MAX_PAYLOAD_SIZE)
+  {
+    fprintf(stderr, _("Error: Invalid payload size\n"));
+    return(-1);
+  }
+
+  transfer->payload_size = payload_size;
+  transfer->max_wait = max_wait;
+
+  return(0);
+}
+
+int dsss_transfer_set_decoding_threads(dsss_transfer_t transfer,
+                                       unsigned int threads)
+{
+  if(is_parallel_decoding(transfer, threads) &&
+     ((transfer->dump != NULL) || (transfer->timeout > 0)))
+  {
+    fprintf(stderr,
+            _("Error: Parallel decoding can't be used with a dump file or a timeout\n"));
+    return(-1);
+  }
+  if(is_parallel_decoding(transfer, threads) &&
+     (transfer->recorder_filename != NULL))
+  {
+    fprintf(stderr,
+            _("Error: Parallel decoding can't be used with the recorder\n"));
+    return(-1);
+  }
+  transfer->decoding_threads = threads;
+
+  return(0);
+}
+
+int dsss_transfer_set_delivery_queue(dsss_transfer_t transfer,
+                                     unsigned int max_bytes,
+                                     char *policy)
+{
+  delivery_policy_t delivery_policy;
+
+  if((policy == NULL) || (strcasecmp(policy, "block") == 0))
+  {
+    delivery_policy = DELIVERY_BLOCK;
+  }
+  else if(strcasecmp(policy, "drop-oldest") == 0)
+  {
+    delivery_policy = DELIVERY_DROP_OLDEST;
+  }
+  else if(strcasecmp(policy, "drop-newest") == 0)
+  {
+    delivery_policy = DELIVERY_DROP_NEWEST;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Unknown delivery policy '%s'\n"), policy);
+    return(-1);
+  }
+
+  transfer->delivery_size = max_bytes;
+  transfer->delivery_policy = delivery_policy;
+
+  return(0);
+}
+
+int dsss_transfer_add_id_callback(dsss_transfer_t transfer,
+                                  char *id,
+                                  dsss_transfer_id_callback callback,
+                                  void *context)
+{
+  char route_id[5];
+  struct id_route_s *route;
+
+  if(id == NULL)
+  {
+    pthread_mutex_lock(&transfer->routes_mutex);
+    transfer->any_id_callback = callback;
+    transfer->any_id_context = context;
+    pthread_mutex_unlock(&transfer->routes_mutex);
+    atomic_fetch_add(&transfer->routes_version, 1);
+    return(0);
+  }
+  if(strlen(id) > 4)
+  {
+    fprintf(stderr, _("Error: Id must be at most 4 bytes long\n"));
+    return(-1);
+  }
+  bzero(route_id, sizeof(route_id));
+  strcpy(route_id, id);
+
+  pthread_mutex_lock(&transfer->routes_mutex);
+  route = find_route(transfer, route_id, 1);
+  if(route)
+  {
+    route->callback = callback;
+    route->context = context;
+  }
+  pthread_mutex_unlock(&transfer->routes_mutex);
+  atomic_fetch_add(&transfer->routes_version, 1);
+  if(route == NULL)
+  {
+    fprintf(stderr, _("Error: Too many ids\n"));
+    return(-1);
+  }
+
+  return(0);
+}
+
+unsigned int dsss_transfer_get_id_stats(dsss_transfer_t transfer,
+                                        dsss_transfer_id_stats_t *stats,
+                                        unsigned int stats_size)
+{
+  unsigned int i;
+  unsigned int n;
+
+  pthread_mutex_lock(&transfer->routes_mutex);
+  n = transfer->routes_size;
+  for(i = 0; (i < n) && (i < stats_size); i++)
+  {
+    stats[i] = transfer->routes[i].stats;
+  }
+  pthread_mutex_unlock(&transfer->routes_mutex);
+
+  return(n);
+}
+
+int dsss_transfer_set_channels(dsss_transfer_t transfer,
+                               unsigned int channels,
+                               char *active)
+{
+  unsigned int *active_channels = NULL;
+  unsigned int active_channels_size = 0;
+  unsigned int *tmp;
+  float channel_rate;
+  char *end;
+  long int index;
+
+  if(channels == 0)
+  {
+    free(transfer->active_channels);
+    transfer->active_channels = NULL;
+    transfer->active_channels_size = 0;
+    transfer->channels = 0;
+    return(0);
+  }
+  if(transfer->emit || transfer->audio_converter)
+  {
+    fprintf(stderr, _("Error: Channels can only be used to receive IQ samples\n"));
+    return(-1);
+  }
+  if((channels < 2) || (channels % 2 != 0))
+  {
+    fprintf(stderr, _("Error: The number of channels must be even\n"));
+    return(-1);
+  }
+  /* The channels overlap by half, their sample rate is twice their width */
+  channel_rate = 2.0 * transfer->sample_rate / channels;
+  if(transfer->bit_rate * transfer->spreading_factor * 2 > channel_rate)
+  {
+    fprintf(stderr, _("Error: The channels are too narrow for the bit rate\n"));
+    return(-1);
+  }
+
+  while(*active != '\0')
+  {
+    index = strtol(active, &end, 10);
+    if((end == active) || (index < -((long int) channels / 2)) ||
+       (index >= (long int) channels / 2))
+    {
+      fprintf(stderr, _("Error: Invalid channel list\n"));
+      free(active_channels);
+      return(-1);
+    }
+    tmp = realloc(active_channels,
+                  (active_channels_size + 1) * sizeof(unsigned int));
+    if(tmp == NULL)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      free(active_channels);
+      return(-1);
+    }
+    active_channels = tmp;
+    /* The outputs of the filterbank for the negative frequencies are after
+     * the ones for the positive frequencies */
+    active_channels[active_channels_size] = (index + channels) % channels;
+    active_channels_size++;
+    active = (*end == ',') ? end + 1 : end;
+  }
+  if(active_channels_size == 0)
+  {
+    fprintf(stderr, _("Error: Invalid channel list\n"));
+    return(-1);
+  }
+
+  free(transfer->active_channels);
+  transfer->active_channels = active_channels;
+  transfer->active_channels_size = active_channels_size;
+  transfer->channels = channels;
+
+  return(0);
+}
+
+void dsss_transfer_set_squelch(dsss_transfer_t transfer, float threshold)
+{
+  transfer->squelch = threshold;
+}
+
+void dsss_transfer_set_fused_frontend(dsss_transfer_t transfer,
+                                      unsigned char enable)
+{
+  transfer->fused_frontend = enable;
+}
+
+int dsss_transfer_set_direct_audio(dsss_transfer_t transfer,
+                                   unsigned char enable)
+{
+  if(transfer->audio_converter == NULL)
+  {
+    fprintf(stderr, _("Error: The direct modem can only be used with audio samples\n"));
+    return(-1);
+  }
+  if(transfer->emit)
+  {
+    /* The Hilbert interpolator works at half the audio rate, which costs
+     * less than modulating at the full rate, and gives the same audio
+     * signal */
+    return(0);
+  }
+  transfer->direct_audio = enable;
+  if(enable)
+  {
+    /* 0 Hz IQ <=> carrier frequency audio */
+    transfer->sample_rate = transfer->audio_sample_rate;
+    transfer->frequency_offset = transfer->audio_frequency;
+  }
+  else
+  {
+    transfer->sample_rate = transfer->audio_sample_rate / 2;
+    transfer->frequency_offset = transfer->audio_frequency - (transfer->sample_rate / 2);
+  }
+  return(0);
+}
+
+void dsss_transfer_get_stats(dsss_transfer_t transfer,
+                             dsss_transfer_stats_t *stats)
+{
+  pthread_mutex_lock(&transfer->stats_mutex);
+  *stats = transfer->stats;
+  if(transfer->delivery)
+  {
+    delivery_get_counts(transfer->delivery,
+                        &stats->queued_bytes,
+                        &stats->dropped_frames,
+                        &stats->dropped_bytes);
+  }
+  if(transfer->dump_writer)
+  {
+    dump_get_counts(transfer->dump_writer,
+                    &stats->dropped_dump_blocks,
+                    &stats->dropped_dump_samples);
+  }
+  if(transfer->measured_frames > 0)
+  {
+    stats->evm_mean = transfer->evm_sum / transfer->measured_frames;
+    stats->rssi_mean = transfer->rssi_sum / transfer->measured_frames;
+    stats->cfo_mean = transfer->cfo_sum / transfer->measured_frames;
+  }
+  pthread_mutex_unlock(&transfer->stats_mutex);
+}
+
+unsigned int dsss_transfer_get_timing(dsss_transfer_t transfer,
+                                      dsss_transfer_timing_t *timings,
+                                      unsigned int timings_size,
+                                      float *realtime_margin)
+{
+  unsigned int i;
+
+  if(transfer->timing == NULL)
+  {
+    return(0);
+  }
+  for(i = 0; (i < TIMING_STAGES) && (i < timings_size); i++)
+  {
+    strncpy(timings[i].name, timing_get_name(i), sizeof(timings[i].name) - 1);
+    timings[i].name[sizeof(timings[i].name) - 1] = '\0';
+    timing_get(transfer->timing,
+               i,
+               &timings[i].count,
+               &timings[i].mean,
+               &timings[i].p50,
+               &timings[i].p99,
+               &timings[i].max);
+  }
+  if(realtime_margin)
+  {
+    *realtime_margin = timing_get_realtime_margin(transfer->timing);
+  }
+  return(i);
 }
 
 void dsss_transfer_print_available_radios()
@@ -23,16 +23,100 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 typedef struct dsss_transfer_s *dsss_transfer_t;
 
-/* Set the verbosity level
+/* Callback receiving the frames of a transfer id
+ *  - context: user-specified pointer given when registering the callback
+ *  - id: transfer id of the frame (null terminated)
+ *  - payload, payload_size: data of the frame
+ */
+typedef int (*dsss_transfer_id_callback)(void *context,
+                                         char *id,
+                                         unsigned char *payload,
+                                         unsigned int payload_size);
+
+/* Statistics of the frames received for a transfer id */
+typedef struct
+{
+  char id[5];
+  /* Frames and bytes passed to a callback */
+  unsigned long int frames;
+  unsigned long int bytes;
+  /* Frames with a valid header but a corrupted payload */
+  unsigned long int corrupted;
+  /* Frames missing in the sequence of frame counters */
+  unsigned long int lost;
+  /* Signal strength and error vector magnitude of the last frame in dB */
+  float rssi;
+  float evm;
+} dsss_transfer_id_stats_t;
+
+/* Statistics of a transfer */
+typedef struct
+{
+  /* Frames passed to the callbacks (or to the delivery queue), or sent */
+  unsigned long long int frames;
+  /* Bytes passed to the callbacks (or to the delivery queue), or sent */
+  unsigned long long int bytes;
+  /* Frames received with a corrupted header */
+  unsigned long long int header_errors;
+  /* Frames received with a valid header but a corrupted payload */
+  unsigned long long int payload_errors;
+  /* Frames received for other transfer ids, ignored or skipped by the frame
+   * synchronizer */
+  unsigned long long int foreign_frames;
+  /* Samples received from the radio, or sent to the radio */
+  unsigned long long int samples;
+  /* Overflows of the receive stream and underflows of the transmit stream
+   * reported by the radio */
+  unsigned long long int overflows;
+  unsigned long long int underflows;
+  /* Mean and worst (highest) error vector magnitude in dB, mean signal
+   * strength in dB and mean carrier frequency offset in Hz of the frames
+   * received with a valid header */
+  float evm_mean;
+  float evm_worst;
+  float rssi_mean;
+  float cfo_mean;
+  /* Bytes waiting in the delivery queue, and frames and bytes dropped
+   * because it was full (see dsss_transfer_set_delivery_queue()) */
+  unsigned long long int queued_bytes;
+  unsigned long long int dropped_frames;
+  unsigned long long int dropped_bytes;
+  /* Blocks and samples not written to the dump file because the writer
+   * was too slow */
+  unsigned long long int dropped_dump_blocks;
+  unsigned long long int dropped_dump_samples;
+} dsss_transfer_stats_t;
+
+/* Processing times of a stage of a transfer, in seconds */
+typedef struct
+{
+  char name[16];
+  /* Number of measures (blocks of samples, or frames for the callback) */
+  unsigned long long int count;
+  double mean;
+  /* Median and 99th percentile, rounded up by at most 25% */
+  double p50;
+  double p99;
+  double max;
+} dsss_transfer_timing_t;
+
+/* Set the default verbosity level
  *  - v: if not 0, print some debug messages to stderr
+ *
+ * The level applies to the transfers created afterwards and to the
+ * existing transfers that have not been started yet, unless they have
+ * their own level set with dsss_transfer_set_verbosity().
  */
 void dsss_transfer_set_verbose(unsigned char v);
 
-/* Get the verbosity level */
+/* Get the default verbosity level */
 unsigned char dsss_transfer_is_verbose();
 
 /* Initialize a new transfer
  *  - radio_driver: radio to use (e.g. "io" or "driver=hackrf")
+ *    "loopback=name" connects a transmitting transfer and a receiving
+ *    transfer of the same process through memory; they must use the same
+ *    sample rate and sample format, and run in different threads
  *  - emit: 1 for transmit mode; 0 for receive mode
  *  - file: in transmit mode, read data from this file
  *          in receive mode, write data to this file
@@ -49,7 +133,7 @@ unsigned char dsss_transfer_is_verbose();
  *  - inner_fec: inner forward error correction code to use
  *  - outer_fec: outer forward error correction code to use
  *  - id: transfer id; when receiving, frames with a different id will be
- *    ignored
+ *    ignored (their payload is not decoded)
  *  - dump: if not NULL, write raw samples sent or received to this file
  *  - timeout: number of seconds after which reception will be stopped if no
  *    frame has been received; 0 means no timeout
@@ -90,7 +174,9 @@ dsss_transfer_t dsss_transfer_create(char *radio_driver,
  * When receiving, the callback must take 'payload_size' bytes from 'payload'
  * and write them somewhere. It must return only when all the bytes have been
  * written. The returned value should be the number of bytes written, but
- * currently it is not used.
+ * currently it is not used. A slow callback delays the reception of the
+ * next frames, unless a delivery queue is used (see
+ * dsss_transfer_set_delivery_queue()).
  * The user-specified 'callback_context' pointer is passed to the callback
  * as 'context'.
  */
@@ -123,9 +209,299 @@ void dsss_transfer_start(dsss_transfer_t transfer);
 /* Interrupt a transfer */
 void dsss_transfer_stop(dsss_transfer_t transfer);
 
-/* Interrupt all transfers */
+/* Interrupt all the transfers that have been started
+ *
+ * The transfers started after the call are not interrupted. This function
+ * can be called from a signal handler.
+ */
 void dsss_transfer_stop_all();
 
+/* Set the verbosity level of a transfer
+ *  - v: if not 0, print some debug messages about this transfer to stderr
+ *
+ * Each transfer keeps its own state, so several transfers can be created
+ * and run by different threads at the same time.
+ */
+void dsss_transfer_set_verbosity(dsss_transfer_t transfer, unsigned char v);
+
+/* Set the format of the IQ samples exchanged with the radio
+ *  - format: "CF32" (complex float, default), "CS16" (complex 16 bit
+ *    integers), "CS8" (complex 8 bit integers), or "native" to use the
+ *    format preferred by the SoapySDR device (CF32 for the other radios)
+ *
+ * With the integer formats, the conversion and the frequency shift are done
+ * in a single pass over the samples. The 'file=' and 'io' radios and the
+ * dump file use the same format.
+ * For a transfer using audio samples, the format is "S16" (16 bit integers,
+ * default) or "F32" (floats), and the dump file
+ * still contains CF32 IQ samples.
+ * If the format can't be used, the function returns -1.
+ */
+int dsss_transfer_set_sample_format(dsss_transfer_t transfer, char *format);
+
+/* Set the format of the samples written to the dump file
+ *  - format: "CF32" (complex float), "CS16" (complex 16 bit integers) or
+ *    "CS8" (complex 8 bit integers)
+ *
+ * By default, the dump file uses the format of the samples exchanged with
+ * the radio. The samples are written by a separate thread, which converts
+ * them if needed; when the disk is too slow, blocks of samples are dropped
+ * instead of making the radio wait (see the 'dropped_dump_blocks'
+ * statistic).
+ * If the format is unknown, the function returns -1.
+ */
+int dsss_transfer_set_dump_format(dsss_transfer_t transfer, char *format);
+
+/* Keep the last received samples in memory, and write them to a file when
+ * a frame event occurs
+ *  - filename: prefix of the files, numbered from 1 ('filename.1',
+ *    'filename.2', etc.); NULL to disable the recorder
+ *  - duration: number of seconds of samples kept in memory
+ *  - events: frames for which the samples are written: "header" (corrupted
+ *    header), "payload" (corrupted payload), "errors" (both, default if
+ *    NULL) or "all" (every frame)
+ *
+ * The files contain the samples in the format used with the radio, ending
+ * shortly after the end of the frame. They are written by a separate
+ * thread; an event occurring while the previous file is being written is
+ * ignored. Two memories of 'duration' seconds of samples are allocated.
+ * If the recorder can't be used, the function returns -1. This is the case
+ * when decoding a 'file=' recording with several threads, as the samples
+ * are then not read in order.
+ */
+int dsss_transfer_set_recorder(dsss_transfer_t transfer,
+                               char *filename,
+                               float duration,
+                               char *events);
+
+/* Use several threads to receive or transmit
+ *  - queue_duration: if not 0, read the samples from the radio, shift and
+ *    resample them, and synchronize the frames in three different threads,
+ *    and connect these threads with queues holding 'queue_duration'
+ *    milliseconds of samples; if 0, do everything in the current thread
+ *
+ * When receiving, the frames are still decoded and passed to the callback
+ * in the thread calling dsss_transfer_start().
+ * When transmitting, one thread reads the payloads in advance with the
+ * callback, one thread modulates them, and the thread calling
+ * dsss_transfer_start() writes the samples to the radio from a queue
+ * holding 'queue_duration' milliseconds of samples. The times when this
+ * queue is empty in the middle of a frame are counted as underflows by
+ * dsss_transfer_get_stats().
+ * In verbose mode, the mean and maximum number of blocks waiting in each
+ * queue are printed, which shows which stage is too slow.
+ */
+void dsss_transfer_set_pipeline(dsss_transfer_t transfer,
+                                unsigned int queue_duration);
+
+/* Set the durations used to size the processing and the frames
+ *  - block_duration: duration of the blocks of samples processed at once,
+ *    in milliseconds (at most 1000); 0 for the default of 50 ms
+ *  - frame_duration: approximate duration of the frames when the payload
+ *    size is automatic (see dsss_transfer_set_coalescing()), in
+ *    milliseconds (at most 10000); 0 for the default of 100 ms
+ *
+ * A frame can't be decoded before the block containing its end has been
+ * received, and a transmitted block is not given to the radio before it is
+ * full or the input is idle, so the latency of a link is at least the
+ * duration of a frame plus about two blocks. Shorter blocks reduce this
+ * latency but increase the processing overhead.
+ * The frame duration doesn't have to match the one of the transmitter,
+ * even when receiving with several decoding threads.
+ * If a duration is invalid, the function returns -1.
+ */
+int dsss_transfer_set_durations(dsss_transfer_t transfer,
+                                unsigned int block_duration,
+                                unsigned int frame_duration);
+
+/* Group the data in fewer and larger frames when transmitting
+ *  - payload_size: maximal number of bytes in the payload of a frame
+ *    (at most 65535); 0 to use frames of approximately 100 ms containing
+ *    between 16 and 8000 bytes
+ *  - max_wait: number of milliseconds during which the callback is called
+ *    again to fill a frame after it returned its first bytes; 0 to send
+ *    each piece of data returned by the callback in its own frame
+ *
+ * Each frame has a preamble, a header and a CRC, so sending small pieces
+ * of data in separate frames wastes most of the air time. With 'max_wait',
+ * a frame is sent when it is full or when the oldest byte it contains has
+ * waited 'max_wait' milliseconds, which bounds the added latency.
+ * When receiving with several decoding threads, 'payload_size' must be
+ * at least the one used by the transmitter; if it is 0, the frames are
+ * assumed to contain up to 65535 bytes, which makes the overlap between
+ * the chunks larger.
+ * If the payload size is invalid, the function returns -1.
+ */
+int dsss_transfer_set_coalescing(dsss_transfer_t transfer,
+                                 unsigned int payload_size,
+                                 unsigned int max_wait);
+
+/* Decode a recording using several threads
+ *  - threads: number of threads to use; 0 or 1 to use only the current thread
+ *
+ * This is only used when receiving IQ samples with the 'file=' radio type.
+ * The recording is split in overlapping chunks that are decoded in parallel,
+ * and the frames are passed to the callback in the order in which they
+ * appear in the recording. The frames found twice in the overlaps are passed
+ * only once.
+ * The chunks are not read in order, so a dump file, a timeout and the
+ * recorder can't be used; in this case the function returns -1. When receiving several
+ * channels, it must be called after dsss_transfer_set_channels().
+ */
+int dsss_transfer_set_decoding_threads(dsss_transfer_t transfer,
+                                       unsigned int threads);
+
+/* Receive several frequency channels at once
+ *  - channels: number of sub-bands in which the band of the radio is split
+ *    by a polyphase filterbank (even); 0 to receive only one signal
+ *  - active: comma separated list of the sub-bands to decode; the sub-band
+ *    'i' is centered 'i * sample_rate / channels' Hz above the frequency of
+ *    the radio, and 'i' must be between '-channels / 2' and
+ *    'channels / 2 - 1'
+ *
+ * The frequency of the radio is still 'frequency - frequency_offset'.
+ * The sub-bands overlap by half and their sample rate is
+ * '2 * sample_rate / channels', which must be at least the rate of the
+ * frame synchronizer. Each active sub-band has its own frame synchronizer,
+ * and they are run by the number of threads set with
+ * dsss_transfer_set_decoding_threads(). The frames of all the sub-bands
+ * are passed to the same callbacks, one at a time.
+ * If the channels can't be used, the function returns -1.
+ */
+int dsss_transfer_set_channels(dsss_transfer_t transfer,
+                               unsigned int channels,
+                               char *active);
+
+/* Skip the frame detection when the channel is idle
+ *  - threshold: if not 0, level in dB above the noise floor under which
+ *    the blocks of samples are not given to the frame synchronizer while
+ *    no frame is being received; if 0, give all the samples to the frame
+ *    synchronizer
+ *
+ * The noise floor is estimated from the energy of the previous blocks.
+ * The last skipped block is given to the frame synchronizer before the
+ * block opening the squelch, so that a preamble starting at the end of a
+ * skipped block is not lost. The squelch only helps when the signal is
+ * received above the noise floor, as the weaker signals don't change the
+ * energy of the blocks enough.
+ * In verbose mode, the proportion of skipped blocks and an estimation of
+ * the processing time saved are printed at the end of the reception.
+ */
+void dsss_transfer_set_squelch(dsss_transfer_t transfer, float threshold);
+
+/* Use the fused front end to receive
+ *  - enable: if not 0, shift the frequency of the samples and decimate them
+ *    by an integer factor in a single pass, computing only the samples kept
+ *    by the decimation, before the resampler; if 0, shift the frequency of
+ *    all the samples and then resample them
+ *
+ * The fused front end is used only when the sample rate is at least four
+ * times the rate of the frame synchronizer.
+ */
+void dsss_transfer_set_fused_frontend(dsss_transfer_t transfer,
+                                      unsigned char enable);
+
+/* Use the direct modem to receive audio samples
+ *  - enable: if not 0, use the audio samples as the real part of IQ samples
+ *    at the rate of the audio samples, and shift them from the carrier
+ *    frequency and decimate them in one pass with the fused front end; if
+ *    0, convert them to IQ samples at half the rate of the audio samples
+ *    with a Hilbert transform first
+ *
+ * The direct modem saves the Hilbert filter, and the decimator only
+ * computes the samples it keeps. The carrier frequency must be higher than
+ * the bandwidth of the signal. A transmitter always uses the Hilbert
+ * transform, which works at half the rate of the audio samples, and the
+ * audio signal is the same in both cases.
+ * If the transfer doesn't use audio samples, the function returns -1.
+ */
+int dsss_transfer_set_direct_audio(dsss_transfer_t transfer,
+                                   unsigned char enable);
+
+/* Pass the received data to the callbacks from a separate thread
+ *  - max_bytes: maximum number of bytes of payload waiting in the queue
+ *    between the frame synchronizer and the writer thread; 0 to call the
+ *    callbacks directly
+ *  - policy: what to do with a new payload when the queue is full:
+ *    "block" (wait until there is some room), "drop-oldest" (discard the
+ *    oldest payloads of the queue) or "drop-newest" (discard the new
+ *    payload); NULL means "block"
+ *
+ * The queue applies to the data callback and to the id callbacks. The
+ * callbacks are called in the order of the frames, one at a time. At the
+ * end of the reception, dsss_transfer_start() returns when all the queued
+ * payloads have been passed to the callbacks. The numbers of queued and
+ * dropped bytes are given by dsss_transfer_get_stats().
+ * If the policy is unknown, the function returns -1.
+ */
+int dsss_transfer_set_delivery_queue(dsss_transfer_t transfer,
+                                     unsigned int max_bytes,
+                                     char *policy);
+
+/* Receive the frames of several transfer ids with the same synchronizer
+ *  - id: transfer id (at most 4 bytes), or NULL to receive the frames of
+ *    any id that has no specific callback
+ *  - callback: function called with the payload of each valid frame
+ *  - context: pointer passed to the callback
+ *
+ * When at least one id callback is registered, the frames are passed to the
+ * id callbacks instead of the callback or file given when creating the
+ * transfer, and the 'id' of the transfer is not used to filter the frames.
+ * Statistics are kept for each registered id, and for each id received by
+ * the callback for any id (up to 256 ids). The callbacks are called in the
+ * thread calling dsss_transfer_start(), or in the thread of the delivery
+ * queue if there is one.
+ * A callback can also be registered while receiving: the frames of its id
+ * are decoded from the next block of samples.
+ * If the callback can't be registered, the function returns -1.
+ */
+int dsss_transfer_add_id_callback(dsss_transfer_t transfer,
+                                  char *id,
+                                  dsss_transfer_id_callback callback,
+                                  void *context);
+
+/* Get the statistics of the received transfer ids
+ *  - stats: array receiving the statistics of at most 'stats_size' ids
+ *
+ * The function returns the number of ids for which statistics are kept,
+ * which can be larger than 'stats_size'. It can be called while the
+ * transfer is running.
+ */
+unsigned int dsss_transfer_get_id_stats(dsss_transfer_t transfer,
+                                        dsss_transfer_id_stats_t *stats,
+                                        unsigned int stats_size);
+
+/* Get the statistics of the transfer
+ *  - stats: structure receiving the statistics
+ *
+ * The statistics are reset by dsss_transfer_start(). The function only
+ * copies them under a lock, so it can be called often from another thread
+ * while the transfer is running.
+ */
+void dsss_transfer_get_stats(dsss_transfer_t transfer,
+                             dsss_transfer_stats_t *stats);
+
+/* Get the processing times of the stages of the transfer
+ *  - timings: array receiving the times of at most 'timings_size' stages
+ *  - realtime_margin: if not NULL, receives the fraction of the duration of
+ *    the signal not used by the 'frontend' and 'framing' stages (negative
+ *    when the processing is slower than real time)
+ *
+ * The stages are 'radio' (reading or writing the samples), 'frontend'
+ * (conversion, frequency shift and resampling), 'framing' (frame generation,
+ * or frame synchronization including the callbacks called for the received
+ * frames) and 'callback' (data callback). The times are only measured when
+ * the library is built with the '--enable-timing' configure option;
+ * otherwise the function returns 0. The function returns the number of
+ * stages written in 'timings'. It can be called while the transfer is
+ * running, and the times are reset by dsss_transfer_start(). In verbose
+ * mode, the times are printed at the end of the transfer.
+ */
+unsigned int dsss_transfer_get_timing(dsss_transfer_t transfer,
+                                      dsss_transfer_timing_t *timings,
+                                      unsigned int timings_size,
+                                      float *realtime_margin);
+
 /* Print list of detected software defined radios */
 void dsss_transfer_print_available_radios();
 
@@ -29,6 +29,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 dsssframegen dsssframegen_create_set(unsigned int _n,
                                      dsssframegenprops_s * _props);
 
+// get an upper bound of the amplitude of the samples written by a DSSS
+// frame generator, which only depends on its pulse-shaping filter
+//  _q       :   frame generator
+float dsssframegen_get_max_amplitude(dsssframegen _q);
+
 // create DSSS frame synchronizer
 //  _n          :   spreading factor
 //  _callback   :   callback function
@@ -37,4 +42,26 @@ dsssframesync dsssframesync_create_set(unsigned int _n,
                                        framesync_callback _callback,
                                        void * _userdata);
 
+// set the ids of the frames to decode with dsssframesync_execute_filtered();
+// the payload of the frames with another id in the first 4 bytes of their
+// header is not decoded, and the callback is not called for them
+//  _q          :   frame synchronizer
+//  _ids        :   ids of 4 bytes, one after the other
+//  _num_ids    :   number of ids (0 to decode all the frames)
+int dsssframesync_set_id_filter(dsssframesync          _q,
+                                const unsigned char *  _ids,
+                                unsigned int           _num_ids);
+
+// get the number of frames skipped by the id filter
+unsigned int dsssframesync_get_num_filtered(dsssframesync _q);
+
+// execute the frame synchronizer, skipping the payloads of the frames whose
+// id is not accepted by the id filter
+//  _q          :   frame synchronizer
+//  _x          :   input samples
+//  _n          :   number of input samples
+int dsssframesync_execute_filtered(dsssframesync   _q,
+                                   float complex * _x,
+                                   unsigned int    _n);
+
 #endif
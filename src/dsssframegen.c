@@ -155,3 +155,26 @@ dsssframegen dsssframegen_create_set(unsigned int _n,
 
     return q;
 }
+
+float dsssframegen_get_max_amplitude(dsssframegen _q)
+{
+    // all the symbols (preamble, header and payload chips) have a magnitude
+    // of 1, so the largest output is obtained when the symbols in one
+    // polyphase branch of the interpolator are aligned with its taps
+    unsigned int h_len = 2 * _q->k * _q->m + 1;
+    float h[h_len];
+    float max_amplitude = 0;
+    float sum;
+    unsigned int i;
+    unsigned int j;
+
+    liquid_firdes_prototype(LIQUID_FIRFILT_ARKAISER, _q->k, _q->m, _q->beta, 0, h);
+    for (i = 0; i < _q->k; i++) {
+        sum = 0;
+        for (j = i; j < h_len; j += _q->k)
+            sum += fabsf(h[j]);
+        if (sum > max_amplitude)
+            max_amplitude = sum;
+    }
+    return max_amplitude;
+}
@@ -47,9 +47,17 @@ THE SOFTWARE.
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define DSSSFRAME_H_USER_DEFAULT 8
 
+// maximum number of ids in the id filter
+#define DSSSFRAMESYNC_MAX_IDS 16
+
+// number of samples given at once to the state machine while looking for
+// the end of a header; the state is checked between the blocks
+#define DSSSFRAMESYNC_DETECT_BLOCK 64
+
 enum state {
     DSSSFRAMESYNC_STATE_DETECTFRAME = 0,
     DSSSFRAMESYNC_STATE_RXPREAMBLE,
@@ -105,6 +113,12 @@ struct dsssframesync_s {
     unsigned int        preamble_counter;
     unsigned int        symbol_counter;
     enum state          state;
+
+    // fields not used by liquid-dsp, after the ones of its own structure
+    unsigned int        n;
+    unsigned int        num_ids;
+    unsigned char       ids[4 * DSSSFRAMESYNC_MAX_IDS];
+    unsigned int        num_filtered;
 };
 
 dsssframesync dsssframesync_create_set(unsigned int _n,
@@ -119,6 +133,7 @@ dsssframesync dsssframesync_create_set(unsigned int _n,
     dsssframesync q = (dsssframesync)calloc(1, sizeof(struct dsssframesync_s));
     q->callback     = _callback;
     q->userdata     = _userdata;
+    q->n            = _n;
 
     q->k    = 2;
     q->m    = 7;
@@ -172,3 +187,77 @@ dsssframesync dsssframesync_create_set(unsigned int _n,
 
     return q;
 }
+
+int dsssframesync_set_id_filter(dsssframesync          _q,
+                                const unsigned char *  _ids,
+                                unsigned int           _num_ids)
+{
+    if (_num_ids > DSSSFRAMESYNC_MAX_IDS) {
+        // too many ids to check quickly, decode all the frames
+        _num_ids = 0;
+    }
+    _q->num_ids = _num_ids;
+    if (_num_ids > 0)
+        memcpy(_q->ids, _ids, 4 * _num_ids);
+    return 0;
+}
+
+unsigned int dsssframesync_get_num_filtered(dsssframesync _q)
+{
+    return _q->num_filtered;
+}
+
+// check the id of the decoded header
+static int dsssframesync_id_wanted(dsssframesync _q)
+{
+    unsigned int i;
+    for (i = 0; i < _q->num_ids; i++) {
+        if (memcmp(_q->header_dec, _q->ids + 4 * i, 4) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+int dsssframesync_execute_filtered(dsssframesync   _q,
+                                   float complex * _x,
+                                   unsigned int    _n)
+{
+    if (_q->num_ids == 0)
+        return dsssframesync_execute(_q, _x, _n);
+
+    // The header is decoded by the state machine of liquid-dsp when the state
+    // changes from RXHEADER to RXPAYLOAD. Give the samples in small blocks
+    // until then, so that the payload of a frame with an unwanted id can be
+    // skipped at most one symbol after the end of its header.
+    unsigned int i = 0;
+    unsigned int block;
+    while (i < _n) {
+        switch (_q->state) {
+        case DSSSFRAMESYNC_STATE_DETECTFRAME:
+        case DSSSFRAMESYNC_STATE_RXPREAMBLE:
+            block = DSSSFRAMESYNC_DETECT_BLOCK;
+            break;
+        case DSSSFRAMESYNC_STATE_RXHEADER:
+            block = _q->k * _q->n;
+            break;
+        default:
+            block = _n - i;
+            break;
+        }
+        if (block > _n - i)
+            block = _n - i;
+
+        enum state state = _q->state;
+        dsssframesync_execute(_q, _x + i, block);
+        i += block;
+
+        if ((state == DSSSFRAMESYNC_STATE_RXHEADER) &&
+            (_q->state == DSSSFRAMESYNC_STATE_RXPAYLOAD) &&
+            !dsssframesync_id_wanted(_q)) {
+            // go back to frame detection without decoding the payload
+            _q->num_filtered++;
+            dsssframesync_reset(_q);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dump.h"
+#include "ring.h"
+
+struct dump_s
+{
+  FILE *file;
+  sample_format_t input_format;
+  sample_format_t output_format;
+  unsigned int input_size;
+  unsigned int output_size;
+  unsigned int block_size;
+  ring_t queue;
+  /* Block being filled by the producer, and number of samples in it */
+  unsigned char *block;
+  unsigned int block_used;
+  /* Conversion buffers of the writer thread */
+  float *converted;
+  void *output;
+  atomic_ullong dropped_blocks;
+  atomic_ullong dropped_samples;
+  pthread_t thread;
+};
+
+void * dump_writer(void *arg)
+{
+  dump_t dump = (dump_t) arg;
+  unsigned char *block;
+  unsigned int size;
+  unsigned int n;
+
+  while((block = ring_read_begin(dump->queue, &size)) != NULL)
+  {
+    n = size / dump->input_size;
+    if(dump->input_format == dump->output_format)
+    {
+      fwrite(block, dump->input_size, n, dump->file);
+      ring_read_end(dump->queue);
+      continue;
+    }
+    /* Convert to the buffer of the writer and release the block before
+     * writing, so that the producer can reuse it sooner */
+    kernel_convert_to_float(dump->input_format,
+                            block,
+                            dump->converted,
+                            2 * n,
+                            1);
+    ring_read_end(dump->queue);
+    kernel_convert_from_float(dump->converted,
+                              dump->output,
+                              2 * n,
+                              dump->output_format,
+                              1);
+    fwrite(dump->output, dump->output_size, n, dump->file);
+  }
+  fflush(dump->file);
+
+  return(NULL);
+}
+
+dump_t dump_create(FILE *file,
+                   sample_format_t input_format,
+                   sample_format_t output_format,
+                   unsigned int block_size,
+                   unsigned int blocks)
+{
+  dump_t dump = malloc(sizeof(struct dump_s));
+
+  if(dump == NULL)
+  {
+    return(NULL);
+  }
+  kernels_init();
+  dump->file = file;
+  dump->input_format = input_format;
+  dump->output_format = output_format;
+  dump->input_size = sample_format_size(input_format);
+  dump->output_size = sample_format_size(output_format);
+  dump->block_size = block_size;
+  dump->block = NULL;
+  dump->block_used = 0;
+  atomic_init(&dump->dropped_blocks, 0);
+  atomic_init(&dump->dropped_samples, 0);
+  dump->queue = ring_create(blocks, block_size * dump->input_size);
+  dump->converted = malloc(block_size * sizeof(complex float));
+  dump->output = malloc(block_size * dump->output_size);
+  if((dump->queue == NULL) ||
+     (dump->converted == NULL) ||
+     (dump->output == NULL) ||
+     (pthread_create(&dump->thread, NULL, dump_writer, dump) != 0))
+  {
+    ring_free(dump->queue);
+    free(dump->converted);
+    free(dump->output);
+    free(dump);
+    return(NULL);
+  }
+
+  return(dump);
+}
+
+void dump_finish(dump_t dump)
+{
+  if(dump->block)
+  {
+    ring_write_end(dump->queue, dump->block_used * dump->input_size);
+    dump->block = NULL;
+  }
+  /* The writer empties the queue before stopping */
+  ring_close(dump->queue);
+  pthread_join(dump->thread, NULL);
+}
+
+void dump_free(dump_t dump)
+{
+  if(dump)
+  {
+    ring_free(dump->queue);
+    free(dump->converted);
+    free(dump->output);
+    free(dump);
+  }
+}
+
+void dump_push(dump_t dump, const void *samples, unsigned int samples_size)
+{
+  const unsigned char *data = samples;
+  unsigned int n;
+
+  while(samples_size > 0)
+  {
+    if(dump->block == NULL)
+    {
+      if(!ring_writable(dump->queue))
+      {
+        /* The samples that don't fit would have filled this many blocks */
+        atomic_fetch_add(&dump->dropped_blocks,
+                         (samples_size + dump->block_size - 1) /
+                         dump->block_size);
+        atomic_fetch_add(&dump->dropped_samples, samples_size);
+        return;
+      }
+      dump->block = ring_write_begin(dump->queue);
+      dump->block_used = 0;
+    }
+    n = dump->block_size - dump->block_used;
+    if(n > samples_size)
+    {
+      n = samples_size;
+    }
+    memcpy(dump->block + dump->block_used * dump->input_size,
+           data,
+           n * dump->input_size);
+    dump->block_used += n;
+    data += n * dump->input_size;
+    samples_size -= n;
+    if(dump->block_used == dump->block_size)
+    {
+      ring_write_end(dump->queue, dump->block_used * dump->input_size);
+      dump->block = NULL;
+    }
+  }
+}
+
+void dump_get_counts(dump_t dump,
+                     unsigned long long int *dropped_blocks,
+                     unsigned long long int *dropped_samples)
+{
+  *dropped_blocks = atomic_load(&dump->dropped_blocks);
+  *dropped_samples = atomic_load(&dump->dropped_samples);
+}
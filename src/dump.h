@@ -0,0 +1,63 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <stdio.h>
+#include "kernels.h"
+
+/* Copy of the samples exchanged with the radio written to a file by its own
+ * writer thread, so that a slow disk doesn't stall the radio. When the
+ * queue of the writer is full, the samples are dropped. */
+typedef struct dump_s *dump_t;
+
+/* Create a writer for samples in 'input_format', and start its thread
+ *  - file: file in which the samples are written
+ *  - output_format: format of the samples in the file
+ *  - block_size: number of samples of the blocks of the queue
+ *  - blocks: number of blocks of the queue
+ * If the creation fails, the function returns NULL. */
+dump_t dump_create(FILE *file,
+                   sample_format_t input_format,
+                   sample_format_t output_format,
+                   unsigned int block_size,
+                   unsigned int blocks);
+
+/* Wait until all the queued samples have been written and stop the writer
+ * thread. No sample can be pushed afterwards. */
+void dump_finish(dump_t dump);
+
+/* Destroy a writer, after dump_finish() */
+void dump_free(dump_t dump);
+
+/* Copy 'samples_size' samples to the queue, without waiting. The samples
+ * that don't fit in the queue are dropped. Only one thread can push
+ * samples. */
+void dump_push(dump_t dump, const void *samples, unsigned int samples_size);
+
+/* Get the number of blocks and the number of samples dropped. The dropped
+ * samples are counted in blocks of 'block_size' samples, rounded up. */
+void dump_get_counts(dump_t dump,
+                     unsigned long long int *dropped_blocks,
+                     unsigned long long int *dropped_samples);
+
+#endif
@@ -0,0 +1,310 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Implementation of the kernels for the NEON instruction set, which is
+ * always available on the processors for which it is compiled */
+
+#include "kernels.h"
+
+#if defined(__ARM_NEON)
+
+#include <arm_neon.h>
+#include <math.h>
+
+#define CS16_SCALE 32768.0f
+#define CS8_SCALE 128.0f
+
+static inline int32x4_t neon_float_to_s32(const float *input,
+                                          float scale,
+                                          float32x4_t limit)
+{
+  float32x4_t v = vmulq_n_f32(vld1q_f32(input), scale);
+
+  v = vmaxq_f32(vminq_f32(v, limit), vnegq_f32(limit));
+#if defined(__aarch64__)
+  return(vcvtnq_s32_f32(v));
+#else
+  /* Round to nearest by adding 0.5 with the sign of the value before the
+   * truncation */
+  v = vaddq_f32(v,
+                vbslq_f32(vcltq_f32(v, vdupq_n_f32(0)),
+                          vdupq_n_f32(-0.5f),
+                          vdupq_n_f32(0.5f)));
+  return(vcvtq_s32_f32(v));
+#endif
+}
+
+static inline float neon_add_lanes(float32x4_t v)
+{
+  float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+
+  return(vget_lane_f32(vpadd_f32(s, s), 0));
+}
+
+static inline float neon_max_lanes(float32x4_t v)
+{
+  float32x2_t m = vmax_f32(vget_low_f32(v), vget_high_f32(v));
+
+  return(vget_lane_f32(vpmax_f32(m, m), 0));
+}
+
+void neon_s16_to_float(const short int *input,
+                       float *output,
+                       unsigned int count,
+                       float gain)
+{
+  float scale = gain / CS16_SCALE;
+  int16x8_t v;
+  unsigned int i;
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    v = vld1q_s16(input + i);
+    vst1q_f32(output + i,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+    vst1q_f32(output + i + 4,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+  }
+  for(; i < count; i++)
+  {
+    output[i] = input[i] * scale;
+  }
+}
+
+void neon_s8_to_float(const signed char *input,
+                      float *output,
+                      unsigned int count,
+                      float gain)
+{
+  float scale = gain / CS8_SCALE;
+  int8x16_t v;
+  int16x8_t low;
+  int16x8_t high;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    v = vld1q_s8(input + i);
+    low = vmovl_s8(vget_low_s8(v));
+    high = vmovl_s8(vget_high_s8(v));
+    vst1q_f32(output + i,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(low))), scale));
+    vst1q_f32(output + i + 4,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(low))), scale));
+    vst1q_f32(output + i + 8,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(high))), scale));
+    vst1q_f32(output + i + 12,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(high))), scale));
+  }
+  for(; i < count; i++)
+  {
+    output[i] = input[i] * scale;
+  }
+}
+
+void neon_float_to_s16(const float *input,
+                       short int *output,
+                       unsigned int count,
+                       float gain)
+{
+  float scale = gain * (CS16_SCALE - 1);
+  float32x4_t limit = vdupq_n_f32(CS16_SCALE);
+  unsigned int i;
+  float x;
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    vst1q_s16(output + i,
+              vcombine_s16(vqmovn_s32(neon_float_to_s32(input + i,
+                                                        scale,
+                                                        limit)),
+                           vqmovn_s32(neon_float_to_s32(input + i + 4,
+                                                        scale,
+                                                        limit))));
+  }
+  for(; i < count; i++)
+  {
+    x = rintf(input[i] * scale);
+    output[i] = (x > CS16_SCALE - 1) ? CS16_SCALE - 1 :
+      (x < -CS16_SCALE) ? -CS16_SCALE :
+      x;
+  }
+}
+
+void neon_float_to_s8(const float *input,
+                      signed char *output,
+                      unsigned int count,
+                      float gain)
+{
+  float scale = gain * (CS8_SCALE - 1);
+  float32x4_t limit = vdupq_n_f32(CS8_SCALE);
+  int16x8_t low;
+  int16x8_t high;
+  unsigned int i;
+  float x;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    low = vcombine_s16(vqmovn_s32(neon_float_to_s32(input + i, scale, limit)),
+                       vqmovn_s32(neon_float_to_s32(input + i + 4,
+                                                    scale,
+                                                    limit)));
+    high = vcombine_s16(vqmovn_s32(neon_float_to_s32(input + i + 8,
+                                                     scale,
+                                                     limit)),
+                        vqmovn_s32(neon_float_to_s32(input + i + 12,
+                                                     scale,
+                                                     limit)));
+    vst1q_s8(output + i, vcombine_s8(vqmovn_s16(low), vqmovn_s16(high)));
+  }
+  for(; i < count; i++)
+  {
+    x = rintf(input[i] * scale);
+    output[i] = (x > CS8_SCALE - 1) ? CS8_SCALE - 1 :
+      (x < -CS8_SCALE) ? -CS8_SCALE :
+      x;
+  }
+}
+
+void neon_scale(const float *input,
+                float *output,
+                unsigned int count,
+                float gain)
+{
+  unsigned int i;
+
+  for(i = 0; i + 4 <= count; i += 4)
+  {
+    vst1q_f32(output + i, vmulq_n_f32(vld1q_f32(input + i), gain));
+  }
+  for(; i < count; i++)
+  {
+    output[i] = input[i] * gain;
+  }
+}
+
+float neon_power(const float *input, unsigned int samples_size, float *peak)
+{
+  float32x4_t sum = vdupq_n_f32(0);
+  float32x4_t maximum = vdupq_n_f32(0);
+  float32x4x2_t v;
+  float32x4_t p;
+  float s;
+  float x;
+  unsigned int i;
+
+  for(i = 0; i + 4 <= samples_size; i += 4)
+  {
+    v = vld2q_f32(input + 2 * i);
+    p = vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]);
+    sum = vaddq_f32(sum, p);
+    maximum = vmaxq_f32(maximum, p);
+  }
+  s = neon_add_lanes(sum);
+  *peak = neon_max_lanes(maximum);
+  for(; i < samples_size; i++)
+  {
+    x = input[2 * i] * input[2 * i] + input[2 * i + 1] * input[2 * i + 1];
+    s += x;
+    *peak = fmaxf(*peak, x);
+  }
+  return(s);
+}
+
+void neon_mix(const float *input,
+              float *output,
+              unsigned int samples_size,
+              mixer_t *mixer,
+              int sign)
+{
+  float re[4];
+  float im[4];
+  float step[2];
+  float32x4_t p_re;
+  float32x4_t p_im;
+  float32x4_t a;
+  float32x4x2_t v;
+  float32x4x2_t y;
+  float x_re;
+  float x_im;
+  unsigned int i;
+  unsigned int l;
+
+  mixer_get_phasors(mixer, sign, samples_size, 4, re, im, step);
+  p_re = vld1q_f32(re);
+  p_im = vld1q_f32(im);
+  for(i = 0; i + 4 <= samples_size; i += 4)
+  {
+    v = vld2q_f32(input + 2 * i);
+    y.val[0] = vmlsq_f32(vmulq_f32(v.val[0], p_re), v.val[1], p_im);
+    y.val[1] = vmlaq_f32(vmulq_f32(v.val[0], p_im), v.val[1], p_re);
+    vst2q_f32(output + 2 * i, y);
+    a = vmlsq_n_f32(vmulq_n_f32(p_re, step[0]), p_im, step[1]);
+    p_im = vmlaq_n_f32(vmulq_n_f32(p_re, step[1]), p_im, step[0]);
+    p_re = a;
+  }
+  vst1q_f32(re, p_re);
+  vst1q_f32(im, p_im);
+  /* Lane 'l' has the phase of sample 'i + l' */
+  for(l = 0; i < samples_size; i++, l++)
+  {
+    x_re = input[2 * i];
+    x_im = input[2 * i + 1];
+    output[2 * i] = x_re * re[l] - x_im * im[l];
+    output[2 * i + 1] = x_re * im[l] + x_im * re[l];
+  }
+}
+
+void neon_dot(const float *input,
+              const float *taps,
+              unsigned int count,
+              float *result)
+{
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  float32x2_t acc;
+  unsigned int i;
+
+  for(i = 0; i < count; i += 8)
+  {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(input + i), vld1q_f32(taps + i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(input + i + 4), vld1q_f32(taps + i + 4));
+  }
+  acc0 = vaddq_f32(acc0, acc1);
+  /* The real parts are in the even lanes and the imaginary parts in the odd
+   * lanes */
+  acc = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+  vst1_f32(result, acc);
+}
+
+const kernel_functions_t kernels_neon =
+  {
+    neon_s16_to_float,
+    neon_s8_to_float,
+    neon_float_to_s16,
+    neon_float_to_s8,
+    neon_scale,
+    neon_power,
+    neon_mix,
+    neon_dot
+  };
+
+#endif
@@ -0,0 +1,871 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Implementations of the kernels for the SSE4.1, AVX2 and AVX-512
+ * instruction sets. The functions are compiled for their instruction set
+ * with the 'target' attribute, so that the library still runs on the
+ * processors that don't support it, and kernels_get_x86() only returns the
+ * implementations that the processor supports. */
+
+#include "kernels.h"
+
+#if defined(KERNELS_X86)
+
+#include <immintrin.h>
+#include <math.h>
+
+#define CS16_SCALE 32768.0f
+#define CS8_SCALE 128.0f
+
+#define SSE4 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2,fma")))
+#define AVX512 __attribute__((target("avx512f")))
+
+/* Scalar code for the samples after the last full vector */
+
+static inline void tail_s16_to_float(const short int *input,
+                                     float *output,
+                                     unsigned int count,
+                                     float scale)
+{
+  unsigned int i;
+
+  for(i = 0; i < count; i++)
+  {
+    output[i] = input[i] * scale;
+  }
+}
+
+static inline void tail_s8_to_float(const signed char *input,
+                                    float *output,
+                                    unsigned int count,
+                                    float scale)
+{
+  unsigned int i;
+
+  for(i = 0; i < count; i++)
+  {
+    output[i] = input[i] * scale;
+  }
+}
+
+static inline void tail_float_to_s16(const float *input,
+                                     short int *output,
+                                     unsigned int count,
+                                     float scale)
+{
+  unsigned int i;
+  float x;
+
+  for(i = 0; i < count; i++)
+  {
+    x = rintf(input[i] * scale);
+    output[i] = (x > CS16_SCALE - 1) ? CS16_SCALE - 1 :
+      (x < -CS16_SCALE) ? -CS16_SCALE :
+      x;
+  }
+}
+
+static inline void tail_float_to_s8(const float *input,
+                                    signed char *output,
+                                    unsigned int count,
+                                    float scale)
+{
+  unsigned int i;
+  float x;
+
+  for(i = 0; i < count; i++)
+  {
+    x = rintf(input[i] * scale);
+    output[i] = (x > CS8_SCALE - 1) ? CS8_SCALE - 1 :
+      (x < -CS8_SCALE) ? -CS8_SCALE :
+      x;
+  }
+}
+
+static inline void tail_scale(const float *input,
+                              float *output,
+                              unsigned int count,
+                              float gain)
+{
+  unsigned int i;
+
+  for(i = 0; i < count; i++)
+  {
+    output[i] = input[i] * gain;
+  }
+}
+
+static inline float tail_power(const float *input,
+                               unsigned int samples_size,
+                               float *peak)
+{
+  float sum = 0;
+  float p;
+  unsigned int i;
+
+  for(i = 0; i < samples_size; i++)
+  {
+    p = input[2 * i] * input[2 * i] + input[2 * i + 1] * input[2 * i + 1];
+    sum += p;
+    if(p > *peak)
+    {
+      *peak = p;
+    }
+  }
+  return(sum);
+}
+
+/* Lane 'l' of 're' and 'im' has the phase of sample 'l' */
+static inline void tail_mix(const float *input,
+                            float *output,
+                            unsigned int samples_size,
+                            const float *re,
+                            const float *im)
+{
+  float x_re;
+  float x_im;
+  unsigned int i;
+
+  for(i = 0; i < samples_size; i++)
+  {
+    x_re = input[2 * i];
+    x_im = input[2 * i + 1];
+    output[2 * i] = x_re * re[i] - x_im * im[i];
+    output[2 * i + 1] = x_re * im[i] + x_im * re[i];
+  }
+}
+
+/* The real parts are in the even lanes and the imaginary parts in the odd
+ * lanes */
+static inline void tail_dot(const float *input,
+                            const float *taps,
+                            unsigned int count,
+                            float *result)
+{
+  unsigned int i;
+
+  for(i = 0; i < count; i += 2)
+  {
+    result[0] += input[i] * taps[i];
+    result[1] += input[i + 1] * taps[i + 1];
+  }
+}
+
+/* SSE4.1, 4 floats per vector */
+
+SSE4 static inline __m128i sse4_float_to_s32(const float *input,
+                                             __m128 scale,
+                                             __m128 limit)
+{
+  __m128 v = _mm_mul_ps(_mm_loadu_ps(input), scale);
+
+  v = _mm_max_ps(_mm_min_ps(v, limit), _mm_sub_ps(_mm_setzero_ps(), limit));
+  return(_mm_cvtps_epi32(v));
+}
+
+SSE4 void sse4_s16_to_float(const short int *input,
+                            float *output,
+                            unsigned int count,
+                            float gain)
+{
+  __m128 scale = _mm_set1_ps(gain / CS16_SCALE);
+  __m128i v;
+  unsigned int i;
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    v = _mm_loadu_si128((const __m128i *) (input + i));
+    _mm_storeu_ps(output + i,
+                  _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(v)), scale));
+    _mm_storeu_ps(output + i + 4,
+                  _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(v, 8))),
+                             scale));
+  }
+  tail_s16_to_float(input + i, output + i, count - i, gain / CS16_SCALE);
+}
+
+SSE4 void sse4_s8_to_float(const signed char *input,
+                           float *output,
+                           unsigned int count,
+                           float gain)
+{
+  __m128 scale = _mm_set1_ps(gain / CS8_SCALE);
+  __m128i v;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    v = _mm_loadu_si128((const __m128i *) (input + i));
+    _mm_storeu_ps(output + i,
+                  _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(v)), scale));
+    _mm_storeu_ps(output + i + 4,
+                  _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(v, 4))),
+                             scale));
+    _mm_storeu_ps(output + i + 8,
+                  _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(v, 8))),
+                             scale));
+    _mm_storeu_ps(output + i + 12,
+                  _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(v, 12))),
+                             scale));
+  }
+  tail_s8_to_float(input + i, output + i, count - i, gain / CS8_SCALE);
+}
+
+SSE4 void sse4_float_to_s16(const float *input,
+                            short int *output,
+                            unsigned int count,
+                            float gain)
+{
+  __m128 scale = _mm_set1_ps(gain * (CS16_SCALE - 1));
+  __m128 limit = _mm_set1_ps(CS16_SCALE);
+  unsigned int i;
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    _mm_storeu_si128((__m128i *) (output + i),
+                     _mm_packs_epi32(sse4_float_to_s32(input + i, scale, limit),
+                                     sse4_float_to_s32(input + i + 4, scale, limit)));
+  }
+  tail_float_to_s16(input + i, output + i, count - i, gain * (CS16_SCALE - 1));
+}
+
+SSE4 void sse4_float_to_s8(const float *input,
+                           signed char *output,
+                           unsigned int count,
+                           float gain)
+{
+  __m128 scale = _mm_set1_ps(gain * (CS8_SCALE - 1));
+  __m128 limit = _mm_set1_ps(CS8_SCALE);
+  __m128i low;
+  __m128i high;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    low = _mm_packs_epi32(sse4_float_to_s32(input + i, scale, limit),
+                          sse4_float_to_s32(input + i + 4, scale, limit));
+    high = _mm_packs_epi32(sse4_float_to_s32(input + i + 8, scale, limit),
+                           sse4_float_to_s32(input + i + 12, scale, limit));
+    _mm_storeu_si128((__m128i *) (output + i), _mm_packs_epi16(low, high));
+  }
+  tail_float_to_s8(input + i, output + i, count - i, gain * (CS8_SCALE - 1));
+}
+
+SSE4 void sse4_scale(const float *input,
+                     float *output,
+                     unsigned int count,
+                     float gain)
+{
+  __m128 scale = _mm_set1_ps(gain);
+  unsigned int i;
+
+  for(i = 0; i + 4 <= count; i += 4)
+  {
+    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_loadu_ps(input + i), scale));
+  }
+  tail_scale(input + i, output + i, count - i, gain);
+}
+
+SSE4 float sse4_power(const float *input, unsigned int samples_size, float *peak)
+{
+  __m128 sum = _mm_setzero_ps();
+  __m128 maximum = _mm_setzero_ps();
+  __m128 a;
+  __m128 b;
+  __m128 p;
+  float result[4];
+  float s;
+  unsigned int i;
+
+  for(i = 0; i + 4 <= samples_size; i += 4)
+  {
+    a = _mm_loadu_ps(input + 2 * i);
+    b = _mm_loadu_ps(input + 2 * i + 4);
+    /* Sums of the squares of the real and imaginary parts of 4 samples */
+    p = _mm_hadd_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b));
+    sum = _mm_add_ps(sum, p);
+    maximum = _mm_max_ps(maximum, p);
+  }
+  _mm_storeu_ps(result, sum);
+  s = result[0] + result[1] + result[2] + result[3];
+  _mm_storeu_ps(result, maximum);
+  *peak = fmaxf(fmaxf(result[0], result[1]), fmaxf(result[2], result[3]));
+  return(s + tail_power(input + 2 * i, samples_size - i, peak));
+}
+
+SSE4 void sse4_mix(const float *input,
+                   float *output,
+                   unsigned int samples_size,
+                   mixer_t *mixer,
+                   int sign)
+{
+  float re[4];
+  float im[4];
+  float step[2];
+  __m128 p_re;
+  __m128 p_im;
+  __m128 s_re;
+  __m128 s_im;
+  __m128 a;
+  __m128 b;
+  __m128 v_re;
+  __m128 v_im;
+  __m128 y_re;
+  __m128 y_im;
+  unsigned int i;
+
+  mixer_get_phasors(mixer, sign, samples_size, 4, re, im, step);
+  p_re = _mm_loadu_ps(re);
+  p_im = _mm_loadu_ps(im);
+  s_re = _mm_set1_ps(step[0]);
+  s_im = _mm_set1_ps(step[1]);
+  for(i = 0; i + 4 <= samples_size; i += 4)
+  {
+    a = _mm_loadu_ps(input + 2 * i);
+    b = _mm_loadu_ps(input + 2 * i + 4);
+    v_re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    v_im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    y_re = _mm_sub_ps(_mm_mul_ps(v_re, p_re), _mm_mul_ps(v_im, p_im));
+    y_im = _mm_add_ps(_mm_mul_ps(v_re, p_im), _mm_mul_ps(v_im, p_re));
+    _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(y_re, y_im));
+    _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(y_re, y_im));
+    a = _mm_sub_ps(_mm_mul_ps(p_re, s_re), _mm_mul_ps(p_im, s_im));
+    p_im = _mm_add_ps(_mm_mul_ps(p_re, s_im), _mm_mul_ps(p_im, s_re));
+    p_re = a;
+  }
+  _mm_storeu_ps(re, p_re);
+  _mm_storeu_ps(im, p_im);
+  tail_mix(input + 2 * i, output + 2 * i, samples_size - i, re, im);
+}
+
+SSE4 void sse4_dot(const float *input,
+                   const float *taps,
+                   unsigned int count,
+                   float *result)
+{
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  unsigned int i;
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(input + i),
+                                       _mm_loadu_ps(taps + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(input + i + 4),
+                                       _mm_loadu_ps(taps + i + 4)));
+  }
+  acc0 = _mm_add_ps(acc0, acc1);
+  acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+  _mm_storel_pi((__m64 *) result, acc0);
+  tail_dot(input + i, taps + i, count - i, result);
+}
+
+/* AVX2, 8 floats per vector. Most instructions work separately on the two
+ * halves of the vectors, which changes the order of the results of the
+ * packing and shuffling instructions. */
+
+AVX2 static inline __m256i avx2_float_to_s32(const float *input,
+                                             __m256 scale,
+                                             __m256 limit)
+{
+  __m256 v = _mm256_mul_ps(_mm256_loadu_ps(input), scale);
+
+  v = _mm256_max_ps(_mm256_min_ps(v, limit),
+                    _mm256_sub_ps(_mm256_setzero_ps(), limit));
+  return(_mm256_cvtps_epi32(v));
+}
+
+AVX2 void avx2_s16_to_float(const short int *input,
+                            float *output,
+                            unsigned int count,
+                            float gain)
+{
+  __m256 scale = _mm256_set1_ps(gain / CS16_SCALE);
+  __m128i v;
+  unsigned int i;
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    v = _mm_loadu_si128((const __m128i *) (input + i));
+    _mm256_storeu_ps(output + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)),
+                                   scale));
+  }
+  tail_s16_to_float(input + i, output + i, count - i, gain / CS16_SCALE);
+}
+
+AVX2 void avx2_s8_to_float(const signed char *input,
+                           float *output,
+                           unsigned int count,
+                           float gain)
+{
+  __m256 scale = _mm256_set1_ps(gain / CS8_SCALE);
+  __m128i v;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    v = _mm_loadu_si128((const __m128i *) (input + i));
+    _mm256_storeu_ps(output + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)),
+                                   scale));
+    _mm256_storeu_ps(output + i + 8,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(v, 8))),
+                                   scale));
+  }
+  tail_s8_to_float(input + i, output + i, count - i, gain / CS8_SCALE);
+}
+
+AVX2 void avx2_float_to_s16(const float *input,
+                            short int *output,
+                            unsigned int count,
+                            float gain)
+{
+  __m256 scale = _mm256_set1_ps(gain * (CS16_SCALE - 1));
+  __m256 limit = _mm256_set1_ps(CS16_SCALE);
+  __m256i v;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    v = _mm256_packs_epi32(avx2_float_to_s32(input + i, scale, limit),
+                           avx2_float_to_s32(input + i + 8, scale, limit));
+    /* Put the quarters back in order: 0-3, 8-11, 4-7, 12-15 */
+    _mm256_storeu_si256((__m256i *) (output + i),
+                        _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  tail_float_to_s16(input + i, output + i, count - i, gain * (CS16_SCALE - 1));
+}
+
+AVX2 void avx2_float_to_s8(const float *input,
+                           signed char *output,
+                           unsigned int count,
+                           float gain)
+{
+  __m256 scale = _mm256_set1_ps(gain * (CS8_SCALE - 1));
+  __m256 limit = _mm256_set1_ps(CS8_SCALE);
+  __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  __m256i low;
+  __m256i high;
+  unsigned int i;
+
+  for(i = 0; i + 32 <= count; i += 32)
+  {
+    low = _mm256_packs_epi32(avx2_float_to_s32(input + i, scale, limit),
+                             avx2_float_to_s32(input + i + 8, scale, limit));
+    high = _mm256_packs_epi32(avx2_float_to_s32(input + i + 16, scale, limit),
+                              avx2_float_to_s32(input + i + 24, scale, limit));
+    /* Each group of 4 bytes comes from a different half of the inputs */
+    _mm256_storeu_si256((__m256i *) (output + i),
+                        _mm256_permutevar8x32_epi32(_mm256_packs_epi16(low, high),
+                                                    order));
+  }
+  tail_float_to_s8(input + i, output + i, count - i, gain * (CS8_SCALE - 1));
+}
+
+AVX2 void avx2_scale(const float *input,
+                     float *output,
+                     unsigned int count,
+                     float gain)
+{
+  __m256 scale = _mm256_set1_ps(gain);
+  unsigned int i;
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    _mm256_storeu_ps(output + i,
+                     _mm256_mul_ps(_mm256_loadu_ps(input + i), scale));
+  }
+  tail_scale(input + i, output + i, count - i, gain);
+}
+
+AVX2 float avx2_power(const float *input, unsigned int samples_size, float *peak)
+{
+  __m256 sum = _mm256_setzero_ps();
+  __m256 maximum = _mm256_setzero_ps();
+  __m256 a;
+  __m256 b;
+  __m256 p;
+  float result[8];
+  float s;
+  unsigned int i;
+
+  for(i = 0; i + 8 <= samples_size; i += 8)
+  {
+    a = _mm256_loadu_ps(input + 2 * i);
+    b = _mm256_loadu_ps(input + 2 * i + 8);
+    /* Squared magnitudes of 8 samples, in a different order */
+    p = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+    sum = _mm256_add_ps(sum, p);
+    maximum = _mm256_max_ps(maximum, p);
+  }
+  _mm256_storeu_ps(result, sum);
+  s = (result[0] + result[1]) + (result[2] + result[3]) +
+    (result[4] + result[5]) + (result[6] + result[7]);
+  _mm256_storeu_ps(result, maximum);
+  *peak = fmaxf(fmaxf(fmaxf(result[0], result[1]), fmaxf(result[2], result[3])),
+                fmaxf(fmaxf(result[4], result[5]), fmaxf(result[6], result[7])));
+  return(s + tail_power(input + 2 * i, samples_size - i, peak));
+}
+
+AVX2 void avx2_mix(const float *input,
+                   float *output,
+                   unsigned int samples_size,
+                   mixer_t *mixer,
+                   int sign)
+{
+  __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+  float re[8];
+  float im[8];
+  float step[2];
+  __m256 p_re;
+  __m256 p_im;
+  __m256 s_re;
+  __m256 s_im;
+  __m256 a;
+  __m256 b;
+  __m256 v_re;
+  __m256 v_im;
+  __m256 y_re;
+  __m256 y_im;
+  unsigned int i;
+
+  mixer_get_phasors(mixer, sign, samples_size, 8, re, im, step);
+  /* The shuffles below give the samples in the order 0, 1, 4, 5, 2, 3, 6, 7,
+   * so the phasors are put in the same order */
+  p_re = _mm256_permutevar8x32_ps(_mm256_loadu_ps(re), order);
+  p_im = _mm256_permutevar8x32_ps(_mm256_loadu_ps(im), order);
+  s_re = _mm256_set1_ps(step[0]);
+  s_im = _mm256_set1_ps(step[1]);
+  for(i = 0; i + 8 <= samples_size; i += 8)
+  {
+    a = _mm256_loadu_ps(input + 2 * i);
+    b = _mm256_loadu_ps(input + 2 * i + 8);
+    v_re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    v_im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    y_re = _mm256_fmsub_ps(v_re, p_re, _mm256_mul_ps(v_im, p_im));
+    y_im = _mm256_fmadd_ps(v_re, p_im, _mm256_mul_ps(v_im, p_re));
+    _mm256_storeu_ps(output + 2 * i, _mm256_unpacklo_ps(y_re, y_im));
+    _mm256_storeu_ps(output + 2 * i + 8, _mm256_unpackhi_ps(y_re, y_im));
+    a = _mm256_fmsub_ps(p_re, s_re, _mm256_mul_ps(p_im, s_im));
+    p_im = _mm256_fmadd_ps(p_re, s_im, _mm256_mul_ps(p_im, s_re));
+    p_re = a;
+  }
+  /* Back to the order of the samples */
+  _mm256_storeu_ps(re, _mm256_permutevar8x32_ps(p_re, order));
+  _mm256_storeu_ps(im, _mm256_permutevar8x32_ps(p_im, order));
+  tail_mix(input + 2 * i, output + 2 * i, samples_size - i, re, im);
+}
+
+AVX2 void avx2_dot(const float *input,
+                   const float *taps,
+                   unsigned int count,
+                   float *result)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  __m128 acc;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(input + i),
+                           _mm256_loadu_ps(taps + i),
+                           acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(input + i + 8),
+                           _mm256_loadu_ps(taps + i + 8),
+                           acc1);
+  }
+  acc0 = _mm256_add_ps(acc0, acc1);
+  acc = _mm_add_ps(_mm256_castps256_ps128(acc0),
+                   _mm256_extractf128_ps(acc0, 1));
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  _mm_storel_pi((__m64 *) result, acc);
+  tail_dot(input + i, taps + i, count - i, result);
+}
+
+/* AVX-512, 16 floats per vector */
+
+AVX512 static inline __m512i avx512_float_to_s32(const float *input,
+                                                 __m512 scale,
+                                                 __m512 limit)
+{
+  __m512 v = _mm512_mul_ps(_mm512_loadu_ps(input), scale);
+
+  v = _mm512_max_ps(_mm512_min_ps(v, limit),
+                    _mm512_sub_ps(_mm512_setzero_ps(), limit));
+  return(_mm512_cvtps_epi32(v));
+}
+
+AVX512 void avx512_s16_to_float(const short int *input,
+                                float *output,
+                                unsigned int count,
+                                float gain)
+{
+  __m512 scale = _mm512_set1_ps(gain / CS16_SCALE);
+  __m256i v;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    v = _mm256_loadu_si256((const __m256i *) (input + i));
+    _mm512_storeu_ps(output + i,
+                     _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(v)),
+                                   scale));
+  }
+  tail_s16_to_float(input + i, output + i, count - i, gain / CS16_SCALE);
+}
+
+AVX512 void avx512_s8_to_float(const signed char *input,
+                               float *output,
+                               unsigned int count,
+                               float gain)
+{
+  __m512 scale = _mm512_set1_ps(gain / CS8_SCALE);
+  __m128i v;
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    v = _mm_loadu_si128((const __m128i *) (input + i));
+    _mm512_storeu_ps(output + i,
+                     _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(v)),
+                                   scale));
+  }
+  tail_s8_to_float(input + i, output + i, count - i, gain / CS8_SCALE);
+}
+
+AVX512 void avx512_float_to_s16(const float *input,
+                                short int *output,
+                                unsigned int count,
+                                float gain)
+{
+  __m512 scale = _mm512_set1_ps(gain * (CS16_SCALE - 1));
+  __m512 limit = _mm512_set1_ps(CS16_SCALE);
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    _mm256_storeu_si256((__m256i *) (output + i),
+                        _mm512_cvtsepi32_epi16(avx512_float_to_s32(input + i,
+                                                                   scale,
+                                                                   limit)));
+  }
+  tail_float_to_s16(input + i, output + i, count - i, gain * (CS16_SCALE - 1));
+}
+
+AVX512 void avx512_float_to_s8(const float *input,
+                               signed char *output,
+                               unsigned int count,
+                               float gain)
+{
+  __m512 scale = _mm512_set1_ps(gain * (CS8_SCALE - 1));
+  __m512 limit = _mm512_set1_ps(CS8_SCALE);
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    _mm_storeu_si128((__m128i *) (output + i),
+                     _mm512_cvtsepi32_epi8(avx512_float_to_s32(input + i,
+                                                               scale,
+                                                               limit)));
+  }
+  tail_float_to_s8(input + i, output + i, count - i, gain * (CS8_SCALE - 1));
+}
+
+AVX512 void avx512_scale(const float *input,
+                         float *output,
+                         unsigned int count,
+                         float gain)
+{
+  __m512 scale = _mm512_set1_ps(gain);
+  unsigned int i;
+
+  for(i = 0; i + 16 <= count; i += 16)
+  {
+    _mm512_storeu_ps(output + i,
+                     _mm512_mul_ps(_mm512_loadu_ps(input + i), scale));
+  }
+  tail_scale(input + i, output + i, count - i, gain);
+}
+
+AVX512 float avx512_power(const float *input,
+                          unsigned int samples_size,
+                          float *peak)
+{
+  __m512 sum = _mm512_setzero_ps();
+  __m512 maximum = _mm512_setzero_ps();
+  __m512 v;
+  __m512 p;
+  float s;
+  unsigned int i;
+
+  for(i = 0; i + 8 <= samples_size; i += 8)
+  {
+    v = _mm512_loadu_ps(input + 2 * i);
+    v = _mm512_mul_ps(v, v);
+    /* Squared magnitude of each sample, in both of its lanes */
+    p = _mm512_add_ps(v, _mm512_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm512_add_ps(sum, p);
+    maximum = _mm512_max_ps(maximum, p);
+  }
+  s = _mm512_reduce_add_ps(sum) / 2;
+  *peak = _mm512_reduce_max_ps(maximum);
+  return(s + tail_power(input + 2 * i, samples_size - i, peak));
+}
+
+AVX512 void avx512_mix(const float *input,
+                       float *output,
+                       unsigned int samples_size,
+                       mixer_t *mixer,
+                       int sign)
+{
+  __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+                                   16, 18, 20, 22, 24, 26, 28, 30);
+  __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15,
+                                  17, 19, 21, 23, 25, 27, 29, 31);
+  __m512i low = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19,
+                                  4, 20, 5, 21, 6, 22, 7, 23);
+  __m512i high = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27,
+                                   12, 28, 13, 29, 14, 30, 15, 31);
+  float re[16];
+  float im[16];
+  float step[2];
+  __m512 p_re;
+  __m512 p_im;
+  __m512 s_re;
+  __m512 s_im;
+  __m512 a;
+  __m512 b;
+  __m512 v_re;
+  __m512 v_im;
+  __m512 y_re;
+  __m512 y_im;
+  unsigned int i;
+
+  mixer_get_phasors(mixer, sign, samples_size, 16, re, im, step);
+  p_re = _mm512_loadu_ps(re);
+  p_im = _mm512_loadu_ps(im);
+  s_re = _mm512_set1_ps(step[0]);
+  s_im = _mm512_set1_ps(step[1]);
+  for(i = 0; i + 16 <= samples_size; i += 16)
+  {
+    a = _mm512_loadu_ps(input + 2 * i);
+    b = _mm512_loadu_ps(input + 2 * i + 16);
+    v_re = _mm512_permutex2var_ps(a, even, b);
+    v_im = _mm512_permutex2var_ps(a, odd, b);
+    y_re = _mm512_fmsub_ps(v_re, p_re, _mm512_mul_ps(v_im, p_im));
+    y_im = _mm512_fmadd_ps(v_re, p_im, _mm512_mul_ps(v_im, p_re));
+    _mm512_storeu_ps(output + 2 * i, _mm512_permutex2var_ps(y_re, low, y_im));
+    _mm512_storeu_ps(output + 2 * i + 16,
+                     _mm512_permutex2var_ps(y_re, high, y_im));
+    a = _mm512_fmsub_ps(p_re, s_re, _mm512_mul_ps(p_im, s_im));
+    p_im = _mm512_fmadd_ps(p_re, s_im, _mm512_mul_ps(p_im, s_re));
+    p_re = a;
+  }
+  _mm512_storeu_ps(re, p_re);
+  _mm512_storeu_ps(im, p_im);
+  tail_mix(input + 2 * i, output + 2 * i, samples_size - i, re, im);
+}
+
+AVX512 void avx512_dot(const float *input,
+                       const float *taps,
+                       unsigned int count,
+                       float *result)
+{
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  unsigned int i;
+
+  for(i = 0; i + 32 <= count; i += 32)
+  {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(input + i),
+                           _mm512_loadu_ps(taps + i),
+                           acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(input + i + 16),
+                           _mm512_loadu_ps(taps + i + 16),
+                           acc1);
+  }
+  acc0 = _mm512_add_ps(acc0, acc1);
+  result[0] = _mm512_mask_reduce_add_ps(0x5555, acc0);
+  result[1] = _mm512_mask_reduce_add_ps(0xaaaa, acc0);
+  tail_dot(input + i, taps + i, count - i, result);
+}
+
+const kernel_functions_t kernels_sse4 =
+  {
+    sse4_s16_to_float,
+    sse4_s8_to_float,
+    sse4_float_to_s16,
+    sse4_float_to_s8,
+    sse4_scale,
+    sse4_power,
+    sse4_mix,
+    sse4_dot
+  };
+
+const kernel_functions_t kernels_avx2 =
+  {
+    avx2_s16_to_float,
+    avx2_s8_to_float,
+    avx2_float_to_s16,
+    avx2_float_to_s8,
+    avx2_scale,
+    avx2_power,
+    avx2_mix,
+    avx2_dot
+  };
+
+const kernel_functions_t kernels_avx512 =
+  {
+    avx512_s16_to_float,
+    avx512_s8_to_float,
+    avx512_float_to_s16,
+    avx512_float_to_s8,
+    avx512_scale,
+    avx512_power,
+    avx512_mix,
+    avx512_dot
+  };
+
+const kernel_functions_t * kernels_get_x86(kernel_set_t set)
+{
+  __builtin_cpu_init();
+  switch(set)
+  {
+  case KERNEL_SET_SSE4:
+    return(__builtin_cpu_supports("sse4.1") ? &kernels_sse4 : NULL);
+
+  case KERNEL_SET_AVX2:
+    return((__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ?
+           &kernels_avx2 :
+           NULL);
+
+  case KERNEL_SET_AVX512:
+    return(__builtin_cpu_supports("avx512f") ? &kernels_avx512 : NULL);
+
+  default:
+    return(NULL);
+  }
+}
+
+#endif
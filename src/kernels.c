@@ -0,0 +1,625 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <complex.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kernels.h"
+
+#define TAU (2 * M_PI)
+
+#define MIN(x, y) ((x < y) ? x : y)
+#define MAX(x, y) ((x > y) ? x : y)
+
+/* Number of samples processed at once. The intermediate results of a tile
+ * stay in the L1 cache, so the format conversion and the frequency shift
+ * only make one pass over the buffers in main memory. The phasors of the
+ * oscillator are computed again exactly for each tile, which prevents
+ * the accumulation of rounding errors. */
+#define TILE_SIZE 1024
+
+/* Number of consecutive samples multiplied by the oscillator at once by the
+ * scalar implementation */
+#define LANES 4
+
+#define CS16_SCALE 32768.0f
+#define CS8_SCALE 128.0f
+
+unsigned int sample_format_size(sample_format_t format)
+{
+  switch(format)
+  {
+  case SAMPLE_FORMAT_CS16:
+    return(2 * sizeof(short int));
+
+  case SAMPLE_FORMAT_CS8:
+    return(2 * sizeof(signed char));
+
+  default:
+    return(sizeof(complex float));
+  }
+}
+
+void mixer_init(mixer_t *mixer, double frequency)
+{
+  mixer->phase = 0;
+  mixer->frequency = frequency;
+}
+
+void mixer_get_phasors(mixer_t *mixer,
+                       int sign,
+                       unsigned int samples_size,
+                       unsigned int lanes,
+                       float *re,
+                       float *im,
+                       float *step)
+{
+  unsigned int l;
+  double phase;
+
+  for(l = 0; l < lanes; l++)
+  {
+    phase = mixer->phase + l * mixer->frequency;
+    re[l] = cos(phase);
+    im[l] = sign * sin(phase);
+  }
+  step[0] = cos(lanes * mixer->frequency);
+  step[1] = sign * sin(lanes * mixer->frequency);
+  mixer->phase = fmod(mixer->phase + samples_size * mixer->frequency, TAU);
+}
+
+/* Scalar implementation, which is also the reference for the tests of the
+ * other ones */
+
+void scalar_s16_to_float(const short int *input,
+                         float *output,
+                         unsigned int count,
+                         float gain)
+{
+  float scale = gain / CS16_SCALE;
+  unsigned int i;
+
+  for(i = 0; i < count; i++)
+  {
+    output[i] = input[i] * scale;
+  }
+}
+
+void scalar_s8_to_float(const signed char *input,
+                        float *output,
+                        unsigned int count,
+                        float gain)
+{
+  float scale = gain / CS8_SCALE;
+  unsigned int i;
+
+  for(i = 0; i < count; i++)
+  {
+    output[i] = input[i] * scale;
+  }
+}
+
+void scalar_float_to_s16(const float *input,
+                         short int *output,
+                         unsigned int count,
+                         float gain)
+{
+  float scale = gain * (CS16_SCALE - 1);
+  unsigned int i;
+  float x;
+
+  for(i = 0; i < count; i++)
+  {
+    x = rintf(input[i] * scale);
+    output[i] = MAX(MIN(x, CS16_SCALE - 1), -CS16_SCALE);
+  }
+}
+
+void scalar_float_to_s8(const float *input,
+                        signed char *output,
+                        unsigned int count,
+                        float gain)
+{
+  float scale = gain * (CS8_SCALE - 1);
+  unsigned int i;
+  float x;
+
+  for(i = 0; i < count; i++)
+  {
+    x = rintf(input[i] * scale);
+    output[i] = MAX(MIN(x, CS8_SCALE - 1), -CS8_SCALE);
+  }
+}
+
+void scalar_scale(const float *input,
+                  float *output,
+                  unsigned int count,
+                  float gain)
+{
+  unsigned int i;
+
+  for(i = 0; i < count; i++)
+  {
+    output[i] = input[i] * gain;
+  }
+}
+
+float scalar_power(const float *input, unsigned int samples_size, float *peak)
+{
+  float sum = 0;
+  float maximum = 0;
+  float p;
+  unsigned int i;
+
+  for(i = 0; i < samples_size; i++)
+  {
+    p = input[2 * i] * input[2 * i] + input[2 * i + 1] * input[2 * i + 1];
+    sum += p;
+    maximum = MAX(maximum, p);
+  }
+  *peak = maximum;
+  return(sum);
+}
+
+void scalar_mix(const float *input,
+                float *output,
+                unsigned int samples_size,
+                mixer_t *mixer,
+                int sign)
+{
+  float re[LANES];
+  float im[LANES];
+  float step[2];
+  float x_re;
+  float x_im;
+  float t;
+  unsigned int i = 0;
+  unsigned int l;
+
+  mixer_get_phasors(mixer, sign, samples_size, LANES, re, im, step);
+  for(; i + LANES <= samples_size; i += LANES)
+  {
+    for(l = 0; l < LANES; l++)
+    {
+      x_re = input[2 * (i + l)];
+      x_im = input[2 * (i + l) + 1];
+      output[2 * (i + l)] = x_re * re[l] - x_im * im[l];
+      output[2 * (i + l) + 1] = x_re * im[l] + x_im * re[l];
+    }
+    for(l = 0; l < LANES; l++)
+    {
+      t = re[l] * step[0] - im[l] * step[1];
+      im[l] = re[l] * step[1] + im[l] * step[0];
+      re[l] = t;
+    }
+  }
+  /* Lane 'l' has the phase of sample 'i + l' */
+  for(l = 0; i < samples_size; i++, l++)
+  {
+    x_re = input[2 * i];
+    x_im = input[2 * i + 1];
+    output[2 * i] = x_re * re[l] - x_im * im[l];
+    output[2 * i + 1] = x_re * im[l] + x_im * re[l];
+  }
+}
+
+void scalar_dot(const float *input,
+                const float *taps,
+                unsigned int count,
+                float *result)
+{
+  float re = 0;
+  float im = 0;
+  unsigned int i;
+
+  for(i = 0; i < count; i += 2)
+  {
+    re += input[i] * taps[i];
+    im += input[i + 1] * taps[i + 1];
+  }
+  result[0] = re;
+  result[1] = im;
+}
+
+const kernel_functions_t kernels_scalar =
+  {
+    scalar_s16_to_float,
+    scalar_s8_to_float,
+    scalar_float_to_s16,
+    scalar_float_to_s8,
+    scalar_scale,
+    scalar_power,
+    scalar_mix,
+    scalar_dot
+  };
+
+/* Implementation in use, selected by kernels_init() */
+const kernel_functions_t *kernels = &kernels_scalar;
+kernel_set_t kernels_selected = KERNEL_SET_SCALAR;
+pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+const kernel_functions_t * kernels_get(kernel_set_t set)
+{
+  switch(set)
+  {
+  case KERNEL_SET_SCALAR:
+    return(&kernels_scalar);
+
+#if defined(KERNELS_X86)
+  case KERNEL_SET_SSE4:
+  case KERNEL_SET_AVX2:
+  case KERNEL_SET_AVX512:
+    return(kernels_get_x86(set));
+#endif
+
+#if defined(__ARM_NEON)
+  case KERNEL_SET_NEON:
+    return(&kernels_neon);
+#endif
+
+  default:
+    return(NULL);
+  }
+}
+
+void kernels_select()
+{
+  int set;
+
+  /* The sets are listed from the slowest to the fastest */
+  for(set = KERNEL_SETS - 1; set >= 0; set--)
+  {
+    if(kernels_get(set))
+    {
+      kernels = kernels_get(set);
+      kernels_selected = set;
+      break;
+    }
+  }
+}
+
+void kernels_init()
+{
+  pthread_once(&kernels_once, kernels_select);
+}
+
+kernel_set_t kernels_get_selected()
+{
+  return(kernels_selected);
+}
+
+const char * kernels_get_name(kernel_set_t set)
+{
+  switch(set)
+  {
+  case KERNEL_SET_SCALAR:
+    return("scalar");
+
+  case KERNEL_SET_SSE4:
+    return("SSE4");
+
+  case KERNEL_SET_AVX2:
+    return("AVX2");
+
+  case KERNEL_SET_AVX512:
+    return("AVX-512");
+
+  case KERNEL_SET_NEON:
+    return("NEON");
+
+  default:
+    return("");
+  }
+}
+
+void kernel_convert_to_float(sample_format_t format,
+                             const void *input,
+                             float *output,
+                             unsigned int count,
+                             float gain)
+{
+  switch(format)
+  {
+  case SAMPLE_FORMAT_CS16:
+    kernels->s16_to_float(input, output, count, gain);
+    break;
+
+  case SAMPLE_FORMAT_CS8:
+    kernels->s8_to_float(input, output, count, gain);
+    break;
+
+  default:
+    if(gain != 1)
+    {
+      kernels->scale(input, output, count, gain);
+    }
+    else if((const void *) output != input)
+    {
+      memmove(output, input, count * sizeof(float));
+    }
+    break;
+  }
+}
+
+void kernel_convert_from_float(const float *input,
+                               void *output,
+                               unsigned int count,
+                               sample_format_t format,
+                               float gain)
+{
+  switch(format)
+  {
+  case SAMPLE_FORMAT_CS16:
+    kernels->float_to_s16(input, output, count, gain);
+    break;
+
+  case SAMPLE_FORMAT_CS8:
+    kernels->float_to_s8(input, output, count, gain);
+    break;
+
+  default:
+    if(gain != 1)
+    {
+      kernels->scale(input, output, count, gain);
+    }
+    else if(output != (const void *) input)
+    {
+      memmove(output, input, count * sizeof(float));
+    }
+    break;
+  }
+}
+
+void kernel_scale(const complex float *input,
+                  complex float *output,
+                  unsigned int samples_size,
+                  float gain)
+{
+  kernels->scale((const float *) input,
+                 (float *) output,
+                 2 * samples_size,
+                 gain);
+}
+
+float kernel_power(const complex float *input,
+                   unsigned int samples_size,
+                   float *peak)
+{
+  float maximum;
+  float sum;
+
+  sum = kernels->power((const float *) input, samples_size, &maximum);
+  if(peak)
+  {
+    *peak = maximum;
+  }
+  return(sum);
+}
+
+void kernel_convert_mix_down(sample_format_t format,
+                             const void *input,
+                             complex float *output,
+                             unsigned int samples_size,
+                             mixer_t *mixer)
+{
+  unsigned int sample_size = sample_format_size(format);
+  unsigned int i;
+  unsigned int n;
+
+  for(i = 0; i < samples_size; i += n)
+  {
+    n = MIN(TILE_SIZE, samples_size - i);
+    kernel_convert_to_float(format,
+                            (const unsigned char *) input + i * sample_size,
+                            (float *) (output + i),
+                            2 * n,
+                            1);
+    if(mixer)
+    {
+      kernels->mix((float *) (output + i),
+                   (float *) (output + i),
+                   n,
+                   mixer,
+                   -1);
+    }
+  }
+}
+
+void kernel_mix_up_convert(const complex float *input,
+                           void *output,
+                           unsigned int samples_size,
+                           sample_format_t format,
+                           mixer_t *mixer)
+{
+  unsigned int sample_size = sample_format_size(format);
+  float tile[2 * TILE_SIZE];
+  unsigned int i;
+  unsigned int n;
+
+  for(i = 0; i < samples_size; i += n)
+  {
+    n = MIN(TILE_SIZE, samples_size - i);
+    if(mixer && (format == SAMPLE_FORMAT_CF32))
+    {
+      kernels->mix((const float *) (input + i),
+                   (float *) ((unsigned char *) output + i * sample_size),
+                   n,
+                   mixer,
+                   1);
+    }
+    else if(mixer)
+    {
+      kernels->mix((const float *) (input + i), tile, n, mixer, 1);
+      kernel_convert_from_float(tile,
+                                (unsigned char *) output + i * sample_size,
+                                2 * n,
+                                format,
+                                1);
+    }
+    else
+    {
+      kernel_convert_from_float((const float *) (input + i),
+                                (unsigned char *) output + i * sample_size,
+                                2 * n,
+                                format,
+                                1);
+    }
+  }
+}
+
+struct decimator_s
+{
+  unsigned int factor;
+  /* Number of coefficients, rounded up to a multiple of 4 */
+  unsigned int taps_size;
+  /* Coefficients in reverse order, each one repeated for the real part and
+   * the imaginary part of the samples */
+  float *taps;
+  mixer_t mixer;
+  int mix;
+  /* The last 'taps_size - 1' samples of the previous calls are kept before
+   * the new samples */
+  complex float *buffer;
+  unsigned int buffer_size;
+  unsigned int buffer_used;
+  /* Position in 'buffer' of the last sample of the next output */
+  unsigned int next;
+};
+
+decimator_t decimator_create(unsigned int factor,
+                             const float *taps,
+                             unsigned int taps_size,
+                             double frequency)
+{
+  decimator_t decimator = malloc(sizeof(struct decimator_s));
+  unsigned int padding;
+  unsigned int i;
+
+  if(decimator == NULL)
+  {
+    return(NULL);
+  }
+  decimator->factor = factor;
+  decimator->taps_size = (taps_size + 3) & ~3;
+  padding = decimator->taps_size - taps_size;
+  decimator->taps = calloc(2 * decimator->taps_size, sizeof(float));
+  /* Room for the history and at least one tile, moved back to the start
+   * only when the end is reached */
+  decimator->buffer_size = decimator->taps_size - 1 +
+    MAX(decimator->taps_size, TILE_SIZE);
+  decimator->buffer = calloc(decimator->buffer_size, sizeof(complex float));
+  if((decimator->taps == NULL) || (decimator->buffer == NULL))
+  {
+    decimator_free(decimator);
+    return(NULL);
+  }
+  for(i = 0; i < taps_size; i++)
+  {
+    decimator->taps[2 * (padding + i)] = taps[taps_size - 1 - i];
+    decimator->taps[2 * (padding + i) + 1] = taps[taps_size - 1 - i];
+  }
+  mixer_init(&decimator->mixer, frequency);
+  decimator->mix = (frequency != 0);
+  decimator->buffer_used = decimator->taps_size - 1;
+  decimator->next = decimator->taps_size - 1;
+
+  return(decimator);
+}
+
+void decimator_free(decimator_t decimator)
+{
+  if(decimator)
+  {
+    free(decimator->buffer);
+    free(decimator->taps);
+    free(decimator);
+  }
+}
+
+unsigned int decimator_get_factor(decimator_t decimator)
+{
+  return(decimator->factor);
+}
+
+unsigned int decimator_get_length(decimator_t decimator)
+{
+  return(decimator->taps_size);
+}
+
+unsigned int decimator_execute(decimator_t decimator,
+                               sample_format_t format,
+                               const void *input,
+                               unsigned int samples_size,
+                               complex float *output)
+{
+  unsigned int sample_size = sample_format_size(format);
+  unsigned int history = decimator->taps_size - 1;
+  unsigned int i;
+  unsigned int n;
+  unsigned int k = 0;
+
+  for(i = 0; i < samples_size; i += n)
+  {
+    if(decimator->buffer_used == decimator->buffer_size)
+    {
+      memmove(decimator->buffer,
+              decimator->buffer + decimator->buffer_used - history,
+              history * sizeof(complex float));
+      decimator->next -= decimator->buffer_used - history;
+      decimator->buffer_used = history;
+    }
+    n = MIN(MIN(TILE_SIZE, samples_size - i),
+            decimator->buffer_size - decimator->buffer_used);
+
+    /* Conversion and frequency shift of the tile, followed by the filtering
+     * while the tile is still in the cache. Only one output out of 'factor'
+     * is computed. */
+    kernel_convert_to_float(format,
+                            (const unsigned char *) input + i * sample_size,
+                            (float *) (decimator->buffer +
+                                       decimator->buffer_used),
+                            2 * n,
+                            1);
+    if(decimator->mix)
+    {
+      kernels->mix((float *) (decimator->buffer + decimator->buffer_used),
+                   (float *) (decimator->buffer + decimator->buffer_used),
+                   n,
+                   &decimator->mixer,
+                   -1);
+    }
+    decimator->buffer_used += n;
+
+    for(; decimator->next < decimator->buffer_used;
+        decimator->next += decimator->factor)
+    {
+      kernels->dot((float *) (decimator->buffer + decimator->next - history),
+                   decimator->taps,
+                   2 * decimator->taps_size,
+                   (float *) (output + k));
+      k++;
+    }
+  }
+
+  return(k);
+}
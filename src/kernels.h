@@ -0,0 +1,227 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <complex.h>
+
+/* Formats of the IQ samples exchanged with the radio */
+typedef enum
+  {
+    SAMPLE_FORMAT_CF32,
+    SAMPLE_FORMAT_CS16,
+    SAMPLE_FORMAT_CS8
+  } sample_format_t;
+
+/* Oscillator shifting the frequency of a stream of samples */
+typedef struct
+{
+  double phase;
+  double frequency;
+} mixer_t;
+
+/* Instruction sets for which the kernels have an implementation */
+typedef enum
+  {
+    KERNEL_SET_SCALAR,
+    KERNEL_SET_SSE4,
+    KERNEL_SET_AVX2,
+    KERNEL_SET_AVX512,
+    KERNEL_SET_NEON,
+    KERNEL_SETS
+  } kernel_set_t;
+
+/* Primitives implemented for each instruction set. The complex samples are
+ * interleaved real and imaginary parts, 'count' is a number of floats or
+ * integers, and 'samples_size' is a number of complex samples. */
+typedef struct
+{
+  /* Convert integers to floats between -1 and 1, multiplied by 'gain' */
+  void (*s16_to_float)(const short int *input,
+                       float *output,
+                       unsigned int count,
+                       float gain);
+  void (*s8_to_float)(const signed char *input,
+                      float *output,
+                      unsigned int count,
+                      float gain);
+  /* Multiply floats by 'gain' and convert them to integers, with
+   * saturation */
+  void (*float_to_s16)(const float *input,
+                       short int *output,
+                       unsigned int count,
+                       float gain);
+  void (*float_to_s8)(const float *input,
+                      signed char *output,
+                      unsigned int count,
+                      float gain);
+  /* Multiply floats by 'gain' */
+  void (*scale)(const float *input,
+                float *output,
+                unsigned int count,
+                float gain);
+  /* Get the sum of the squared magnitudes of complex samples, and put the
+   * largest one in 'peak' */
+  float (*power)(const float *input, unsigned int samples_size, float *peak);
+  /* Multiply complex samples by the phasors of an oscillator, to shift
+   * their frequency down if 'sign' is -1, or up if 'sign' is 1 */
+  void (*mix)(const float *input,
+              float *output,
+              unsigned int samples_size,
+              mixer_t *mixer,
+              int sign);
+  /* Get the dot product of complex samples with coefficients repeated for
+   * the real and imaginary parts. 'count' is a multiple of 8 floats, and
+   * the real and imaginary parts of the result are put in 'result'. */
+  void (*dot)(const float *input,
+              const float *taps,
+              unsigned int count,
+              float *result);
+} kernel_functions_t;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/* The x86 implementations are compiled with function attributes, and used
+ * only if the processor supports them */
+#define KERNELS_X86
+#endif
+
+/* Select the fastest implementation of the kernels supported by the
+ * processor. Only the first call has an effect. */
+void kernels_init();
+
+/* Get the implementation of the kernels for 'set', or NULL if it is not
+ * compiled in or not supported by the processor */
+const kernel_functions_t * kernels_get(kernel_set_t set);
+
+/* Get the instruction set of the implementation in use */
+kernel_set_t kernels_get_selected();
+
+/* Get the name of an instruction set */
+const char * kernels_get_name(kernel_set_t set);
+
+/* Get the size in bytes of a sample in 'format' */
+unsigned int sample_format_size(sample_format_t format);
+
+/* Initialize an oscillator
+ *  - frequency: frequency shift in radians per sample
+ */
+void mixer_init(mixer_t *mixer, double frequency);
+
+/* Get the phasors of the oscillator for the next 'lanes' samples and the
+ * rotation for 'lanes' samples, then advance it by 'samples_size' samples.
+ * 'sign' is -1 to shift the frequency down, and 1 to shift it up.
+ * Used by the implementations of 'mix'. */
+void mixer_get_phasors(mixer_t *mixer,
+                       int sign,
+                       unsigned int samples_size,
+                       unsigned int lanes,
+                       float *re,
+                       float *im,
+                       float *step);
+
+/* Implementations for x86 processors, defined in kernels-x86.c */
+const kernel_functions_t * kernels_get_x86(kernel_set_t set);
+
+/* Implementation for ARM processors, defined in kernels-neon.c */
+extern const kernel_functions_t kernels_neon;
+
+/* Convert 'count' values from 'format' to floats multiplied by 'gain'.
+ * 'input' and 'output' can be the same buffer if 'format' is CF32. */
+void kernel_convert_to_float(sample_format_t format,
+                             const void *input,
+                             float *output,
+                             unsigned int count,
+                             float gain);
+
+/* Multiply 'count' floats by 'gain' and convert them to 'format', with
+ * saturation.
+ * 'input' and 'output' can be the same buffer if 'format' is CF32. */
+void kernel_convert_from_float(const float *input,
+                               void *output,
+                               unsigned int count,
+                               sample_format_t format,
+                               float gain);
+
+/* Multiply 'samples_size' complex samples by 'gain' */
+void kernel_scale(const complex float *input,
+                  complex float *output,
+                  unsigned int samples_size,
+                  float gain);
+
+/* Get the sum of the squared magnitudes of 'samples_size' complex samples.
+ * If 'peak' is not NULL, put the largest squared magnitude in it. */
+float kernel_power(const complex float *input,
+                   unsigned int samples_size,
+                   float *peak);
+
+/* Convert 'samples_size' samples from 'format' to complex float, and shift
+ * them 'mixer->frequency' lower. If 'mixer' is NULL, only convert.
+ * 'input' and 'output' can be the same buffer if 'format' is CF32. */
+void kernel_convert_mix_down(sample_format_t format,
+                             const void *input,
+                             complex float *output,
+                             unsigned int samples_size,
+                             mixer_t *mixer);
+
+/* Shift 'samples_size' complex float samples 'mixer->frequency' higher and
+ * convert them to 'format', with saturation. If 'mixer' is NULL, only
+ * convert.
+ * 'input' and 'output' can be the same buffer if 'format' is CF32. */
+void kernel_mix_up_convert(const complex float *input,
+                           void *output,
+                           unsigned int samples_size,
+                           sample_format_t format,
+                           mixer_t *mixer);
+
+/* Frequency shift followed by a decimation by an integer factor */
+typedef struct decimator_s *decimator_t;
+
+/* Create a decimator
+ *  - factor: decimation factor
+ *  - taps: coefficients of the low pass filter (at the input sample rate)
+ *  - taps_size: number of coefficients
+ *  - frequency: frequency shift in radians per sample (can be 0)
+ * If the creation fails, the function returns NULL. */
+decimator_t decimator_create(unsigned int factor,
+                             const float *taps,
+                             unsigned int taps_size,
+                             double frequency);
+
+/* Destroy a decimator */
+void decimator_free(decimator_t decimator);
+
+/* Get the decimation factor */
+unsigned int decimator_get_factor(decimator_t decimator);
+
+/* Get the number of input samples needed to push the last samples out of
+ * the filter */
+unsigned int decimator_get_length(decimator_t decimator);
+
+/* Convert 'samples_size' samples from 'format', shift them down and decimate
+ * them. The output buffer must have room for 'samples_size / factor + 1'
+ * samples. Return the number of output samples. */
+unsigned int decimator_execute(decimator_t decimator,
+                               sample_format_t format,
+                               const void *input,
+                               unsigned int samples_size,
+                               complex float *output);
+
+#endif
@@ -0,0 +1,192 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loopback.h"
+#include "ring.h"
+
+#define MIN(x, y) ((x < y) ? x : y)
+
+/* The queue holds 32 blocks of 64 KiB (a few milliseconds of samples at
+ * high sample rates) */
+#define LOOPBACK_SLOTS 32
+#define LOOPBACK_SLOT_SIZE 65536
+
+struct loopback_s
+{
+  char *name;
+  unsigned int references;
+  /* Sides of the link already opened, and whether it has been closed */
+  unsigned char transmitter;
+  unsigned char receiver;
+  unsigned char closed;
+  ring_t ring;
+  /* Block being read, and position of the next byte to read in it */
+  unsigned char *block;
+  unsigned int block_size;
+  unsigned int block_offset;
+  struct loopback_s *next;
+};
+
+/* Links currently opened */
+struct loopback_s *loopbacks = NULL;
+pthread_mutex_t loopbacks_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+loopback_t loopback_open(char *name, unsigned char emit)
+{
+  loopback_t loopback;
+  unsigned char *side;
+
+  pthread_mutex_lock(&loopbacks_mutex);
+  for(loopback = loopbacks; loopback; loopback = loopback->next)
+  {
+    if(strcmp(loopback->name, name) == 0)
+    {
+      break;
+    }
+  }
+  if(loopback == NULL)
+  {
+    loopback = calloc(1, sizeof(struct loopback_s));
+    if(loopback)
+    {
+      loopback->name = strdup(name);
+      loopback->ring = ring_create(LOOPBACK_SLOTS, LOOPBACK_SLOT_SIZE);
+      if((loopback->name == NULL) || (loopback->ring == NULL))
+      {
+        free(loopback->name);
+        ring_free(loopback->ring);
+        free(loopback);
+        loopback = NULL;
+      }
+      else
+      {
+        loopback->next = loopbacks;
+        loopbacks = loopback;
+      }
+    }
+  }
+  if(loopback)
+  {
+    /* Only one transmitter and one receiver can use a link, and only
+     * once */
+    side = emit ? &loopback->transmitter : &loopback->receiver;
+    if(*side || loopback->closed)
+    {
+      loopback = NULL;
+    }
+    else
+    {
+      *side = 1;
+      loopback->references++;
+    }
+  }
+  pthread_mutex_unlock(&loopbacks_mutex);
+
+  return(loopback);
+}
+
+void loopback_release(loopback_t loopback)
+{
+  loopback_t *link;
+
+  loopback_close(loopback);
+  pthread_mutex_lock(&loopbacks_mutex);
+  loopback->references--;
+  if(loopback->references == 0)
+  {
+    for(link = &loopbacks; *link != loopback; link = &(*link)->next)
+    {
+    }
+    *link = loopback->next;
+    ring_free(loopback->ring);
+    free(loopback->name);
+    free(loopback);
+  }
+  pthread_mutex_unlock(&loopbacks_mutex);
+}
+
+unsigned int loopback_write(loopback_t loopback,
+                            const void *data,
+                            unsigned int size)
+{
+  unsigned char *block;
+  unsigned int n;
+  unsigned int i;
+
+  for(i = 0; i < size; i += n)
+  {
+    block = ring_write_begin(loopback->ring);
+    if(block == NULL)
+    {
+      break;
+    }
+    n = MIN(size - i, LOOPBACK_SLOT_SIZE);
+    memcpy(block, (const unsigned char *) data + i, n);
+    ring_write_end(loopback->ring, n);
+  }
+
+  return(i);
+}
+
+unsigned int loopback_read(loopback_t loopback, void *data, unsigned int size)
+{
+  unsigned int n;
+  unsigned int i;
+
+  for(i = 0; i < size; i += n)
+  {
+    if(loopback->block == NULL)
+    {
+      if((i > 0) && !ring_readable(loopback->ring))
+      {
+        /* Like a radio, return the samples already there instead of waiting
+         * for the writer to send more */
+        break;
+      }
+      loopback->block = ring_read_begin(loopback->ring, &loopback->block_size);
+      loopback->block_offset = 0;
+      if(loopback->block == NULL)
+      {
+        break;
+      }
+    }
+    n = MIN(size - i, loopback->block_size - loopback->block_offset);
+    memcpy((unsigned char *) data + i, loopback->block + loopback->block_offset, n);
+    loopback->block_offset += n;
+    if(loopback->block_offset == loopback->block_size)
+    {
+      ring_read_end(loopback->ring);
+      loopback->block = NULL;
+    }
+  }
+
+  return(i);
+}
+
+void loopback_close(loopback_t loopback)
+{
+  pthread_mutex_lock(&loopbacks_mutex);
+  loopback->closed = 1;
+  pthread_mutex_unlock(&loopbacks_mutex);
+  ring_close(loopback->ring);
+}
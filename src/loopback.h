@@ -0,0 +1,57 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+/* In-memory link carrying a stream of bytes from a transmitting transfer to
+ * a receiving transfer of the same process. The links are identified by
+ * their name, and both sides can be opened in any order. */
+typedef struct loopback_s *loopback_t;
+
+/* Get the transmitting side of the link called 'name' if 'emit' is 1, or
+ * its receiving side if 'emit' is 0, creating the link if it doesn't exist
+ * yet. If the creation fails, if this side is already used, or if the link
+ * has already been closed, the function returns NULL. */
+loopback_t loopback_open(char *name, unsigned char emit);
+
+/* Release a link obtained with loopback_open(). The link is closed, and it
+ * is destroyed when both sides have released it. */
+void loopback_release(loopback_t loopback);
+
+/* Write 'size' bytes to the link. Wait while the link is full.
+ * Return the number of bytes written, which is less than 'size' if the link
+ * has been closed. */
+unsigned int loopback_write(loopback_t loopback,
+                            const void *data,
+                            unsigned int size);
+
+/* Read at most 'size' bytes from the link. Wait while the link is empty,
+ * then read the bytes already written.
+ * Return the number of bytes read, which is 0 if the link has been closed
+ * and all the bytes have been read. The writes of whole samples are read
+ * as whole samples. */
+unsigned int loopback_read(loopback_t loopback, void *data, unsigned int size);
+
+/* Close the link: the reader gets the remaining bytes and then the end of
+ * the stream, and the writer can't write anymore */
+void loopback_close(loopback_t loopback);
+
+#endif
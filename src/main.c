@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include "dsss-transfer.h"
 #include "gettext.h"
@@ -50,17 +51,29 @@ void usage()
   printf(_("Usage: dsss-transfer [options] [filename]\n"));
   printf("\n");
   printf(_("Options:\n"));
+  printf("  -A\n");
+  printf(_("    Use audio samples, with a receiver shifting and decimating\n"
+           "    them directly from the carrier frequency (implies '-a').\n"));
   printf("  -a\n");
   printf(_("    Use audio samples instead of IQ samples.\n"));
   printf(_("  -b <bit rate>  (default: 100 b/s)\n"));
   printf(_("    Bit rate of the DSSS transmission.\n"));
   printf(_("  -c <ppm>  (default: 0.0, can be negative)\n"));
   printf(_("    Correction for the radio clock.\n"));
-  printf(_("  -d <filename>\n"));
+  printf("  -D\n");
+  printf(_("    In 'receive' mode, shift the frequency and decimate the\n"
+           "    samples in a single pass before resampling them.\n"));
+  printf(_("  -d <filename[:format]>\n"));
   printf(_("    Dump a copy of the samples sent to or received from\n"
-           "    the radio.\n"));
+           "    the radio, optionally converted to CF32, CS16 or CS8.\n"));
   printf(_("  -e <fec[,fec]>  (default: h128,none)\n"));
   printf(_("    Inner and outer forward error correction codes to use.\n"));
+  printf(_("  -F <format>  (default: CF32)\n"));
+  printf(_("    Format of the IQ samples exchanged with the radio: CF32, CS16,\n"
+           "    CS8, or 'native' to use the format of the SoapySDR device\n"
+           "    (CF32 for the other radios).\n"
+           "    With '-a', format of the audio samples: S16 (default) or F32\n"
+           "    (floats).\n"));
   printf(_("  -f <frequency>  (default: 434000000 Hz)\n"));
   printf(_("    Frequency of the DSSS transmission.\n"));
   printf(_("  -g <gain>  (default: 0)\n"));
@@ -70,13 +83,59 @@ void usage()
   printf(_("  -i <id>  (default: \"\")\n"));
   printf(_("    Transfer id (at most 4 bytes). When receiving, the frames\n"
            "    with a different id will be ignored.\n"));
+  printf(_("  -j <threads>  (default: 1)\n"));
+  printf(_("    When receiving IQ samples from a 'file=' radio, decode the\n"
+           "    recording in parallel using 'threads' threads ('-d', '-R'\n"
+           "    and '-T' can't be used in this case).\n"
+           "    With '-m', decode the sub-bands using 'threads' threads.\n"));
+  printf(_("  -L <block[:frame]>  (default: 50:100 ms)\n"));
+  printf(_("    Duration of the blocks of samples processed at once, and\n"
+           "    approximate duration of the frames. Shorter durations give\n"
+           "    a lower latency.\n"));
+  printf(_("  -m <channels:list>  (default: none)\n"));
+  printf(_("    In 'receive' mode, split the band of the radio into 'channels'\n"
+           "    sub-bands and decode the sub-bands in the comma separated\n"
+           "    'list'. Sub-band 'i' is centered 'i * sample rate / channels'\n"
+           "    Hz above the frequency of the radio.\n"));
   printf(_("  -n <factor>  (default: 64, must be between 2 and 64)\n"));
   printf(_("    Spectrum spreading factor.\n"));
   printf(_("  -o <offset>  (default: 0 Hz, can be negative)\n"));
   printf(_("    Set the central frequency of the transceiver 'offset' Hz\n"
            "    lower than the signal frequency to send or receive.\n"));
+  printf(_("  -P <size[:wait]>  (default: 0)\n"));
+  printf(_("    In 'transmit' mode, put at most 'size' bytes of data in each\n"
+           "    frame, and wait at most 'wait' milliseconds for more data\n"
+           "    before sending a frame which is not full.\n"
+           "    A size of 0 means frames of approximately 100 ms.\n"
+           "    In 'receive' mode with '-j', 'size' must be at least the one\n"
+           "    of the transmitter (0 means at most 65535 bytes).\n"));
+  printf(_("  -p <duration>  (default: 0 ms)\n"));
+  printf(_("    In 'receive' mode, use separate threads for the radio, the\n"
+           "    signal processing and the frame decoding, connected by\n"
+           "    queues holding 'duration' milliseconds of samples.\n"
+           "    In 'transmit' mode, use separate threads for reading the\n"
+           "    data, the modulation and the radio, with a queue holding\n"
+           "    'duration' milliseconds of samples for the radio.\n"
+           "    A duration of 0 means that everything is done in one thread.\n"));
+  printf(_("  -q <size[:policy]>  (default: 0)\n"));
+  printf(_("    In 'receive' mode, write the decoded data from a separate\n"
+           "    thread, through a queue holding at most 'size' bytes.\n"
+           "    When the queue is full, 'policy' can be 'block' (wait, the\n"
+           "    default), 'drop-oldest' or 'drop-newest'.\n"
+           "    A size of 0 means that the data is written directly.\n"));
+  printf(_("  -R <filename:seconds[:events]>\n"));
+  printf(_("    In 'receive' mode, keep the last 'seconds' of samples in\n"
+           "    memory, and write them to 'filename.1', 'filename.2', etc.\n"
+           "    when a frame event occurs. 'events' can be 'header'\n"
+           "    (corrupted header), 'payload' (corrupted payload), 'errors'\n"
+           "    (both, the default) or 'all' (every frame).\n"));
   printf(_("  -r <radio>  (default: \"\")\n"));
   printf(_("    Radio to use.\n"));
+  printf(_("  -S <threshold>  (default: 0 dB)\n"));
+  printf(_("    In 'receive' mode, don't look for frames in the blocks of\n"
+           "    samples whose level is less than 'threshold' dB above the\n"
+           "    noise floor. A threshold of 0 means that all the blocks are\n"
+           "    used.\n"));
   printf(_("  -s <sample rate>  (default: 2000000 S/s)\n"));
   printf(_("    Sample rate to use.\n"));
   printf(_("  -T <timeout>  (default: 0 s)\n"));
@@ -107,8 +166,12 @@ void usage()
            "The 'file=path-to-file' radio type reads/writes the samples\n"
            "from/to 'path-to-file'.\n"
            "The IQ samples must be in 'complex float' format\n"
-           "(32 bits for the real part, 32 bits for the imaginary part).\n"
-           "The audio samples must be in 'signed integer' format (16 bits).\n"));
+           "(32 bits for the real part, 32 bits for the imaginary part),\n"
+           "or in the format selected with the '-F' option (CS16: 16 bits\n"
+           "integers, CS8: 8 bits integers). The dump file also uses this\n"
+           "format, unless another one is given with the '-d' option.\n"
+           "The audio samples must be in 'signed integer' format (16 bits),\n"
+           "or in 'float' format (32 bits) with the '-F F32' option.\n"));
   printf("\n");
   printf(_("The gain parameter can be specified either as an integer to set a\n"
            "global gain, or as a series of keys and values to set specific\n"
@@ -178,11 +241,30 @@ int main(int argc, char **argv)
   char *id = "";
   char *file = NULL;
   char *dump = NULL;
+  char *dump_format = NULL;
+  char *recorder_file = NULL;
+  float recorder_duration = 0;
+  char *recorder_events = NULL;
   float final_delay = 0;
   unsigned int final_delay_sec = 0;
   unsigned int final_delay_usec = 0;
   unsigned int timeout = 0;
   unsigned char audio = 0;
+  unsigned char direct_audio = 0;
+  unsigned int pipeline = 0;
+  unsigned int decoding_threads = 1;
+  char *sample_format = NULL;
+  unsigned char fused_frontend = 0;
+  unsigned int channels = 0;
+  char *active_channels = "";
+  float squelch = 0;
+  unsigned int delivery_size = 0;
+  char *delivery_policy = NULL;
+  unsigned int block_duration = 0;
+  unsigned int frame_duration = 0;
+  unsigned int payload_size = 0;
+  unsigned int max_wait = 0;
+  char *end;
   int opt;
 
   strcpy(inner_fec, "h128");
@@ -193,10 +275,15 @@ int main(int argc, char **argv)
   bindtextdomain(PACKAGE, LOCALEDIR);
   textdomain(PACKAGE);
 
-  while((opt = getopt(argc, argv, "ab:c:d:e:f:g:hi:n:o:r:s:T:tvw:")) != -1)
+  while((opt = getopt(argc, argv, "Aab:c:Dd:e:F:f:g:hi:j:L:m:n:o:P:p:q:R:r:S:s:T:tvw:")) != -1)
   {
     switch(opt)
     {
+    case 'A':
+      audio = 1;
+      direct_audio = 1;
+      break;
+
     case 'a':
       audio = 1;
       break;
@@ -209,14 +296,33 @@ int main(int argc, char **argv)
       ppm = strtof(optarg, NULL);
       break;
 
+    case 'D':
+      fused_frontend = 1;
+      break;
+
     case 'd':
       dump = optarg;
+      /* The format is recognized only if it is known, so that a ':' can
+       * still be used in the filename */
+      end = strrchr(optarg, ':');
+      if((end != NULL) &&
+         ((strcasecmp(end + 1, "CF32") == 0) ||
+          (strcasecmp(end + 1, "CS16") == 0) ||
+          (strcasecmp(end + 1, "CS8") == 0)))
+      {
+        *end = '\0';
+        dump_format = end + 1;
+      }
       break;
 
     case 'e':
       get_fec_schemes(optarg, inner_fec, outer_fec);
       break;
 
+    case 'F':
+      sample_format = optarg;
+      break;
+
     case 'f':
       frequency = strtoul(optarg, NULL, 10);
       break;
@@ -233,6 +339,26 @@ int main(int argc, char **argv)
       id = optarg;
       break;
 
+    case 'j':
+      decoding_threads = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'L':
+      block_duration = strtoul(optarg, &end, 10);
+      if(*end == ':')
+      {
+        frame_duration = strtoul(end + 1, NULL, 10);
+      }
+      break;
+
+    case 'm':
+      channels = strtoul(optarg, &active_channels, 10);
+      if(*active_channels == ':')
+      {
+        active_channels++;
+      }
+      break;
+
     case 'n':
       spreading_factor = strtoul(optarg, NULL, 10);
       break;
@@ -241,10 +367,55 @@ int main(int argc, char **argv)
       frequency_offset = strtol(optarg, NULL, 10);
       break;
 
+    case 'P':
+      payload_size = strtoul(optarg, &end, 10);
+      if(*end == ':')
+      {
+        max_wait = strtoul(end + 1, NULL, 10);
+      }
+      break;
+
+    case 'p':
+      pipeline = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'q':
+      delivery_size = strtoul(optarg, &delivery_policy, 10);
+      if(*delivery_policy == ':')
+      {
+        delivery_policy++;
+      }
+      else
+      {
+        delivery_policy = NULL;
+      }
+      break;
+
+    case 'R':
+      recorder_file = optarg;
+      end = strrchr(optarg, ':');
+      if((end != NULL) && (strspn(end + 1, "0123456789.") != strlen(end + 1)))
+      {
+        /* The events follow the duration */
+        *end = '\0';
+        recorder_events = end + 1;
+        end = strrchr(optarg, ':');
+      }
+      if(end != NULL)
+      {
+        *end = '\0';
+        recorder_duration = strtof(end + 1, NULL);
+      }
+      break;
+
     case 'r':
       radio_driver = optarg;
       break;
 
+    case 'S':
+      squelch = strtof(optarg, NULL);
+      break;
+
     case 's':
       sample_rate = strtoul(optarg, NULL, 10);
       break;
@@ -304,6 +475,62 @@ int main(int argc, char **argv)
     fprintf(stderr, _("Error: Failed to initialize transfer\n"));
     return(EXIT_FAILURE);
   }
+  if((sample_format != NULL) &&
+     (dsss_transfer_set_sample_format(transfer, sample_format) < 0))
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  if((dump_format != NULL) &&
+     (dsss_transfer_set_dump_format(transfer, dump_format) < 0))
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  if((recorder_file != NULL) &&
+     (dsss_transfer_set_recorder(transfer,
+                                 recorder_file,
+                                 recorder_duration,
+                                 recorder_events) < 0))
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  if(direct_audio && (dsss_transfer_set_direct_audio(transfer, 1) < 0))
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_set_pipeline(transfer, pipeline);
+  if(dsss_transfer_set_durations(transfer, block_duration, frame_duration) < 0)
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  if(dsss_transfer_set_coalescing(transfer, payload_size, max_wait) < 0)
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_set_fused_frontend(transfer, fused_frontend);
+  dsss_transfer_set_squelch(transfer, squelch);
+  if(dsss_transfer_set_channels(transfer, channels, active_channels) < 0)
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  if(dsss_transfer_set_decoding_threads(transfer, decoding_threads) < 0)
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
+  if(dsss_transfer_set_delivery_queue(transfer,
+                                      delivery_size,
+                                      delivery_policy) < 0)
+  {
+    dsss_transfer_free(transfer);
+    return(EXIT_FAILURE);
+  }
   dsss_transfer_start(transfer);
   if(final_delay > 0)
   {
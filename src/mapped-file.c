@@ -0,0 +1,128 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mapped-file.h"
+
+/* The pages already read are released by groups of this size */
+#define RELEASE_SIZE (64 * 1024 * 1024)
+
+struct mapped_file_s
+{
+  unsigned char *data;
+  size_t size;
+  size_t position;
+  size_t released;
+  size_t page_size;
+};
+
+mapped_file_t mapped_file_create(int fd)
+{
+  mapped_file_t file;
+  struct stat file_stat;
+  void *data;
+
+  if((fstat(fd, &file_stat) != 0) ||
+     !S_ISREG(file_stat.st_mode) ||
+     (file_stat.st_size <= 0) ||
+     ((unsigned long long int) file_stat.st_size > SIZE_MAX))
+  {
+    return(NULL);
+  }
+  data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if(data == MAP_FAILED)
+  {
+    return(NULL);
+  }
+  file = malloc(sizeof(struct mapped_file_s));
+  if(file == NULL)
+  {
+    munmap(data, file_stat.st_size);
+    return(NULL);
+  }
+  file->data = data;
+  file->size = file_stat.st_size;
+  file->position = 0;
+  file->released = 0;
+  file->page_size = sysconf(_SC_PAGESIZE);
+
+  /* These are only hints, the mapping works even if they are refused */
+  madvise(file->data, file->size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise(file->data, file->size, MADV_HUGEPAGE);
+#endif
+
+  return(file);
+}
+
+void mapped_file_free(mapped_file_t file)
+{
+  if(file)
+  {
+    munmap(file->data, file->size);
+    free(file);
+  }
+}
+
+size_t mapped_file_get_size(mapped_file_t file)
+{
+  return(file->size);
+}
+
+const void * mapped_file_get(mapped_file_t file,
+                             unsigned long long int offset,
+                             size_t *size)
+{
+  if(offset >= file->size)
+  {
+    *size = 0;
+    return(NULL);
+  }
+  if(*size > file->size - offset)
+  {
+    *size = file->size - offset;
+  }
+  return(file->data + offset);
+}
+
+const void * mapped_file_read(mapped_file_t file, size_t *size)
+{
+  const void *data;
+  size_t end;
+
+  /* Release the pages that have been read, so that the memory used by a
+   * large file stays bounded. They are still in the page cache. */
+  end = file->position - (file->position % file->page_size);
+  if(end - file->released >= RELEASE_SIZE)
+  {
+    madvise(file->data + file->released, end - file->released, MADV_DONTNEED);
+    file->released = end;
+  }
+
+  data = mapped_file_get(file, file->position, size);
+  file->position += *size;
+
+  return(data);
+}
@@ -0,0 +1,55 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+/* Regular file mapped in memory for reading, so that its content can be
+ * used without copying it */
+typedef struct mapped_file_s *mapped_file_t;
+
+/* Map the file opened as 'fd', which must be a regular file that is not
+ * empty. The file is expected to be read sequentially.
+ * If the mapping fails, the function returns NULL. */
+mapped_file_t mapped_file_create(int fd);
+
+/* Unmap a file */
+void mapped_file_free(mapped_file_t file);
+
+/* Get the size of the file in bytes */
+size_t mapped_file_get_size(mapped_file_t file);
+
+/* Get the address of the bytes of the file starting at 'offset'. 'size' is
+ * the number of bytes wanted, it is reduced if the end of the file is
+ * reached. */
+const void * mapped_file_get(mapped_file_t file,
+                             unsigned long long int offset,
+                             size_t *size);
+
+/* Get the address of the next 'size' bytes after those returned by the
+ * previous call, and reduce 'size' if the end of the file is reached. The
+ * pages before them are released, the previous bytes must not be used
+ * anymore. */
+const void * mapped_file_read(mapped_file_t file, size_t *size);
+
+#endif
@@ -0,0 +1,282 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "recorder.h"
+
+/* Circular buffer of samples */
+struct memory_s
+{
+  unsigned char *data;
+  /* Index of the next sample to write, and number of valid samples */
+  unsigned int position;
+  unsigned int used;
+};
+
+/* The producer fills one memory while the writer thread writes the other
+ * one to a file */
+struct recorder_s
+{
+  char *filename;
+  unsigned int sample_size;
+  unsigned int samples_size;
+  struct memory_s memories[2];
+  struct memory_s *active;
+  /* Memory to write, or NULL when the writer is idle */
+  struct memory_s *segment;
+  atomic_int triggered;
+  int finished;
+  unsigned long long int segments;
+  unsigned long long int missed;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+/* Write the samples of a memory to the file of the next segment.
+ * Return 0 if the file can't be created. */
+int write_segment(recorder_t recorder, struct memory_s *memory)
+{
+  char name[strlen(recorder->filename) + 24];
+  FILE *file;
+  unsigned int start;
+
+  snprintf(name,
+           sizeof(name),
+           "%s.%llu",
+           recorder->filename,
+           recorder->segments + 1);
+  file = fopen(name, "wb");
+  if(file == NULL)
+  {
+    return(0);
+  }
+  /* Oldest samples first */
+  start = (memory->used < recorder->samples_size) ? 0 : memory->position;
+  fwrite(memory->data + start * recorder->sample_size,
+         recorder->sample_size,
+         memory->used - start,
+         file);
+  fwrite(memory->data, recorder->sample_size, start, file);
+  fclose(file);
+
+  return(1);
+}
+
+void * recorder_writer(void *arg)
+{
+  recorder_t recorder = (recorder_t) arg;
+  struct memory_s *segment;
+  int written;
+
+  pthread_mutex_lock(&recorder->mutex);
+  while(1)
+  {
+    while((recorder->segment == NULL) && !recorder->finished)
+    {
+      pthread_cond_wait(&recorder->cond, &recorder->mutex);
+    }
+    segment = recorder->segment;
+    if(segment == NULL)
+    {
+      /* Finished and nothing to write */
+      break;
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+
+    written = write_segment(recorder, segment);
+
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->segments += written;
+    recorder->segment = NULL;
+  }
+  pthread_mutex_unlock(&recorder->mutex);
+
+  return(NULL);
+}
+
+recorder_t recorder_create(char *filename,
+                           unsigned int sample_size,
+                           unsigned int samples_size)
+{
+  recorder_t recorder = malloc(sizeof(struct recorder_s));
+  unsigned int i;
+
+  if(recorder == NULL)
+  {
+    return(NULL);
+  }
+  recorder->filename = strdup(filename);
+  recorder->sample_size = sample_size;
+  recorder->samples_size = samples_size;
+  for(i = 0; i < 2; i++)
+  {
+    recorder->memories[i].data = malloc((size_t) samples_size * sample_size);
+    recorder->memories[i].position = 0;
+    recorder->memories[i].used = 0;
+  }
+  recorder->active = &recorder->memories[0];
+  recorder->segment = NULL;
+  atomic_init(&recorder->triggered, 0);
+  recorder->finished = 0;
+  recorder->segments = 0;
+  recorder->missed = 0;
+  if((recorder->filename == NULL) ||
+     (recorder->memories[0].data == NULL) ||
+     (recorder->memories[1].data == NULL))
+  {
+    free(recorder->memories[0].data);
+    free(recorder->memories[1].data);
+    free(recorder->filename);
+    free(recorder);
+    return(NULL);
+  }
+  pthread_mutex_init(&recorder->mutex, NULL);
+  pthread_cond_init(&recorder->cond, NULL);
+  if(pthread_create(&recorder->thread, NULL, recorder_writer, recorder) != 0)
+  {
+    pthread_cond_destroy(&recorder->cond);
+    pthread_mutex_destroy(&recorder->mutex);
+    free(recorder->memories[0].data);
+    free(recorder->memories[1].data);
+    free(recorder->filename);
+    free(recorder);
+    return(NULL);
+  }
+
+  return(recorder);
+}
+
+/* Give the active memory to the writer thread if it is idle, and continue
+ * with the other one. Return 0 if the writer is busy. */
+int start_segment(recorder_t recorder)
+{
+  int started = 0;
+
+  pthread_mutex_lock(&recorder->mutex);
+  if(recorder->segment == NULL)
+  {
+    recorder->segment = recorder->active;
+    recorder->active = (recorder->active == &recorder->memories[0]) ?
+      &recorder->memories[1] :
+      &recorder->memories[0];
+    recorder->active->position = 0;
+    recorder->active->used = 0;
+    pthread_cond_signal(&recorder->cond);
+    started = 1;
+  }
+  else
+  {
+    recorder->missed++;
+  }
+  pthread_mutex_unlock(&recorder->mutex);
+
+  return(started);
+}
+
+void recorder_finish(recorder_t recorder)
+{
+  if(atomic_exchange(&recorder->triggered, 0) &&
+     (recorder->active->used > 0))
+  {
+    start_segment(recorder);
+  }
+  /* The writer writes the pending segment before stopping */
+  pthread_mutex_lock(&recorder->mutex);
+  recorder->finished = 1;
+  pthread_cond_signal(&recorder->cond);
+  pthread_mutex_unlock(&recorder->mutex);
+  pthread_join(recorder->thread, NULL);
+}
+
+void recorder_free(recorder_t recorder)
+{
+  if(recorder)
+  {
+    pthread_cond_destroy(&recorder->cond);
+    pthread_mutex_destroy(&recorder->mutex);
+    free(recorder->memories[0].data);
+    free(recorder->memories[1].data);
+    free(recorder->filename);
+    free(recorder);
+  }
+}
+
+void recorder_push(recorder_t recorder,
+                   const void *samples,
+                   unsigned int samples_size)
+{
+  struct memory_s *memory = recorder->active;
+  const unsigned char *data = samples;
+  unsigned int n;
+
+  /* Only the last samples fit in the memory */
+  if(samples_size > recorder->samples_size)
+  {
+    data += (size_t) (samples_size - recorder->samples_size) *
+      recorder->sample_size;
+    samples_size = recorder->samples_size;
+  }
+  while(samples_size > 0)
+  {
+    n = recorder->samples_size - memory->position;
+    if(n > samples_size)
+    {
+      n = samples_size;
+    }
+    memcpy(memory->data + (size_t) memory->position * recorder->sample_size,
+           data,
+           (size_t) n * recorder->sample_size);
+    memory->position = (memory->position + n) % recorder->samples_size;
+    if(memory->used < recorder->samples_size)
+    {
+      memory->used = (memory->used + n < recorder->samples_size) ?
+        memory->used + n :
+        recorder->samples_size;
+    }
+    data += (size_t) n * recorder->sample_size;
+    samples_size -= n;
+  }
+
+  if(atomic_exchange(&recorder->triggered, 0))
+  {
+    start_segment(recorder);
+  }
+}
+
+void recorder_trigger(recorder_t recorder)
+{
+  atomic_store(&recorder->triggered, 1);
+}
+
+void recorder_get_counts(recorder_t recorder,
+                         unsigned long long int *segments,
+                         unsigned long long int *missed)
+{
+  pthread_mutex_lock(&recorder->mutex);
+  *segments = recorder->segments;
+  *missed = recorder->missed;
+  pthread_mutex_unlock(&recorder->mutex);
+}
@@ -0,0 +1,64 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+/* Rolling memory of the last received samples, written to a file only when
+ * it is triggered (for example by a frame which could not be decoded), so
+ * that the samples before an event can be examined without dumping
+ * everything. The files are written by a separate thread. */
+typedef struct recorder_s *recorder_t;
+
+/* Create a recorder keeping the last 'samples_size' samples of 'sample_size'
+ * bytes, and start its writer thread. The segments are written to files
+ * named 'filename.1', 'filename.2', etc.
+ * If the creation fails, the function returns NULL. */
+recorder_t recorder_create(char *filename,
+                           unsigned int sample_size,
+                           unsigned int samples_size);
+
+/* Write the segment requested by a last trigger, if any, and stop the writer
+ * thread. No sample can be pushed afterwards. */
+void recorder_finish(recorder_t recorder);
+
+/* Destroy a recorder, after recorder_finish() */
+void recorder_free(recorder_t recorder);
+
+/* Add some samples to the memory, and if the recorder has been triggered,
+ * pass the content of the memory to the writer thread. Only one thread can
+ * push samples. */
+void recorder_push(recorder_t recorder,
+                   const void *samples,
+                   unsigned int samples_size);
+
+/* Request the writing of the samples in memory, at the next push. Can be
+ * called by any thread. */
+void recorder_trigger(recorder_t recorder);
+
+/* Get the number of segments written (not counting the files that could
+ * not be created), and the number of triggers ignored
+ * because the writer thread was still writing the previous segment */
+void recorder_get_counts(recorder_t recorder,
+                         unsigned long long int *segments,
+                         unsigned long long int *missed);
+
+#endif
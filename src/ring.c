@@ -0,0 +1,207 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "ring.h"
+
+struct ring_s
+{
+  unsigned int slots;
+  unsigned int slot_size;
+  unsigned char *data;
+  unsigned int *sizes;
+  /* 'head' counts the published blocks and is only written by the producer,
+   * 'tail' counts the released blocks and is only written by the consumer */
+  atomic_uint head;
+  atomic_uint tail;
+  atomic_int closed;
+  atomic_int waiters;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  /* Written by the producer, and read by any thread */
+  atomic_ullong depth_sum;
+  atomic_ullong depth_count;
+  atomic_uint depth_max;
+};
+
+ring_t ring_create(unsigned int slots, unsigned int slot_size)
+{
+  ring_t ring = malloc(sizeof(struct ring_s));
+
+  if(ring == NULL)
+  {
+    return(NULL);
+  }
+  ring->slots = slots;
+  ring->slot_size = slot_size;
+  ring->data = malloc((size_t) slots * slot_size);
+  ring->sizes = malloc(slots * sizeof(unsigned int));
+  if((ring->data == NULL) || (ring->sizes == NULL))
+  {
+    free(ring->data);
+    free(ring->sizes);
+    free(ring);
+    return(NULL);
+  }
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->closed, 0);
+  atomic_init(&ring->waiters, 0);
+  pthread_mutex_init(&ring->mutex, NULL);
+  pthread_cond_init(&ring->cond, NULL);
+  atomic_init(&ring->depth_sum, 0);
+  atomic_init(&ring->depth_count, 0);
+  atomic_init(&ring->depth_max, 0);
+
+  return(ring);
+}
+
+void ring_free(ring_t ring)
+{
+  if(ring)
+  {
+    pthread_cond_destroy(&ring->cond);
+    pthread_mutex_destroy(&ring->mutex);
+    free(ring->sizes);
+    free(ring->data);
+    free(ring);
+  }
+}
+
+int ring_writable(ring_t ring)
+{
+  return(atomic_load(&ring->head) - atomic_load(&ring->tail) < ring->slots);
+}
+
+int ring_readable(ring_t ring)
+{
+  return(atomic_load(&ring->head) != atomic_load(&ring->tail));
+}
+
+/* The waiter registers itself before checking the condition again, and the
+ * other side checks for waiters after updating its index, therefore at least
+ * one of them sees the change of the other and no wake up can be lost. */
+void ring_wait(ring_t ring, int (*ready)(ring_t))
+{
+  pthread_mutex_lock(&ring->mutex);
+  atomic_fetch_add(&ring->waiters, 1);
+  while(!ready(ring) && !atomic_load(&ring->closed))
+  {
+    pthread_cond_wait(&ring->cond, &ring->mutex);
+  }
+  atomic_fetch_sub(&ring->waiters, 1);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+void ring_wake(ring_t ring)
+{
+  if(atomic_load(&ring->waiters) > 0)
+  {
+    pthread_mutex_lock(&ring->mutex);
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+  }
+}
+
+void * ring_write_begin(ring_t ring)
+{
+  if(!ring_writable(ring))
+  {
+    ring_wait(ring, ring_writable);
+  }
+  if(atomic_load(&ring->closed))
+  {
+    return(NULL);
+  }
+  return(ring->data +
+         (size_t) (atomic_load(&ring->head) % ring->slots) * ring->slot_size);
+}
+
+void ring_write_end(ring_t ring, unsigned int size)
+{
+  unsigned int head = atomic_load(&ring->head);
+  unsigned int depth = head + 1 - atomic_load(&ring->tail);
+
+  ring->sizes[head % ring->slots] = size;
+  atomic_store(&ring->head, head + 1);
+  ring_wake(ring);
+
+  atomic_fetch_add(&ring->depth_sum, depth);
+  atomic_fetch_add(&ring->depth_count, 1);
+  if(depth > atomic_load(&ring->depth_max))
+  {
+    atomic_store(&ring->depth_max, depth);
+  }
+}
+
+void * ring_read_begin(ring_t ring, unsigned int *size)
+{
+  unsigned int index;
+
+  if(!ring_readable(ring))
+  {
+    ring_wait(ring, ring_readable);
+    if(!ring_readable(ring))
+    {
+      /* Closed and empty */
+      return(NULL);
+    }
+  }
+  index = atomic_load(&ring->tail) % ring->slots;
+  *size = ring->sizes[index];
+  return(ring->data + (size_t) index * ring->slot_size);
+}
+
+void ring_read_end(ring_t ring)
+{
+  atomic_fetch_add(&ring->tail, 1);
+  ring_wake(ring);
+}
+
+void ring_close(ring_t ring)
+{
+  pthread_mutex_lock(&ring->mutex);
+  atomic_store(&ring->closed, 1);
+  pthread_cond_broadcast(&ring->cond);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+unsigned int ring_get_slots(ring_t ring)
+{
+  return(ring->slots);
+}
+
+void ring_get_depth(ring_t ring, float *mean, unsigned int *maximum)
+{
+  unsigned long long int count = atomic_load(&ring->depth_count);
+
+  if(mean)
+  {
+    *mean = (count > 0) ?
+      (float) atomic_load(&ring->depth_sum) / count :
+      0;
+  }
+  if(maximum)
+  {
+    *maximum = atomic_load(&ring->depth_max);
+  }
+}
@@ -0,0 +1,71 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RING_H
+#define RING_H
+
+/* Bounded queue of blocks between exactly one producer thread and one
+ * consumer thread. The indexes are updated without locks; a mutex is only
+ * taken when one side has to sleep because the queue is full or empty. */
+typedef struct ring_s *ring_t;
+
+/* Create a queue of 'slots' blocks of at most 'slot_size' bytes.
+ * If the creation fails, the function returns NULL. */
+ring_t ring_create(unsigned int slots, unsigned int slot_size);
+
+/* Destroy a queue */
+void ring_free(ring_t ring);
+
+/* Get a free block to fill. Wait if the queue is full.
+ * Return NULL if the queue has been closed. */
+void * ring_write_begin(ring_t ring);
+
+/* Publish the block obtained with ring_write_begin(), containing 'size'
+ * bytes */
+void ring_write_end(ring_t ring, unsigned int size);
+
+/* Get the oldest published block and put its size in 'size'. Wait if the
+ * queue is empty.
+ * Return NULL if the queue has been closed and all the blocks have been
+ * read. */
+void * ring_read_begin(ring_t ring, unsigned int *size);
+
+/* Release the block obtained with ring_read_begin() */
+void ring_read_end(ring_t ring);
+
+/* Check whether a block can be read without waiting */
+int ring_readable(ring_t ring);
+
+/* Check whether a block can be written without waiting */
+int ring_writable(ring_t ring);
+
+/* Close the queue and wake up the waiting threads.
+ * Can be called by the producer or by the consumer. */
+void ring_close(ring_t ring);
+
+/* Get the number of slots of the queue */
+unsigned int ring_get_slots(ring_t ring);
+
+/* Get the mean and maximum number of blocks waiting in the queue, measured
+ * each time a block is published. It can be called by any thread while the
+ * queue is used. */
+void ring_get_depth(ring_t ring, float *mean, unsigned int *maximum);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
+#include "timing.h"
+
+/* The buckets have a logarithmic scale with 4 buckets per octave of
+ * nanoseconds, from 0 ns to about 4 s */
+#define BUCKETS 128
+
+struct histogram_s
+{
+  unsigned long long int count;
+  double sum;
+  double maximum;
+  unsigned long long int buckets[BUCKETS];
+};
+
+struct timing_s
+{
+  struct histogram_s histograms[TIMING_STAGES];
+  double signal;
+  pthread_mutex_t mutex;
+};
+
+const char *stage_names[TIMING_STAGES] =
+  {
+    "radio",
+    "frontend",
+    "framing",
+    "callback"
+  };
+
+timing_t timing_create()
+{
+  timing_t timing = malloc(sizeof(struct timing_s));
+
+  if(timing == NULL)
+  {
+    return(NULL);
+  }
+  bzero(timing->histograms, sizeof(timing->histograms));
+  timing->signal = 0;
+  pthread_mutex_init(&timing->mutex, NULL);
+
+  return(timing);
+}
+
+void timing_free(timing_t timing)
+{
+  if(timing)
+  {
+    pthread_mutex_destroy(&timing->mutex);
+    free(timing);
+  }
+}
+
+void timing_reset(timing_t timing)
+{
+  pthread_mutex_lock(&timing->mutex);
+  bzero(timing->histograms, sizeof(timing->histograms));
+  timing->signal = 0;
+  pthread_mutex_unlock(&timing->mutex);
+}
+
+double timing_now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return(now.tv_sec + now.tv_nsec / 1e9);
+}
+
+unsigned int get_bucket(double seconds)
+{
+  unsigned long long int ns = (seconds > 0) ? seconds * 1e9 : 0;
+  unsigned int octave;
+
+  if(ns < 4)
+  {
+    return(ns);
+  }
+  octave = 63 - __builtin_clzll(ns);
+  if(octave > BUCKETS / 4)
+  {
+    return(BUCKETS - 1);
+  }
+  return(4 * (octave - 1) + ((ns >> (octave - 2)) & 3));
+}
+
+/* Get the upper bound of a bucket in seconds */
+double get_bucket_limit(unsigned int bucket)
+{
+  bucket++;
+  if(bucket < 4)
+  {
+    return(bucket / 1e9);
+  }
+  return((double) ((4ULL + (bucket & 3)) << (bucket / 4 - 1)) / 1e9);
+}
+
+void timing_add(timing_t timing, timing_stage_t stage, double seconds)
+{
+  struct histogram_s *histogram = &timing->histograms[stage];
+
+  pthread_mutex_lock(&timing->mutex);
+  histogram->count++;
+  histogram->sum += seconds;
+  if(seconds > histogram->maximum)
+  {
+    histogram->maximum = seconds;
+  }
+  histogram->buckets[get_bucket(seconds)]++;
+  pthread_mutex_unlock(&timing->mutex);
+}
+
+void timing_add_signal(timing_t timing, double seconds)
+{
+  pthread_mutex_lock(&timing->mutex);
+  timing->signal += seconds;
+  pthread_mutex_unlock(&timing->mutex);
+}
+
+const char * timing_get_name(timing_stage_t stage)
+{
+  return(stage_names[stage]);
+}
+
+/* Get the upper bound of the bucket containing the 'quantile' of the
+ * measures, without going over the maximum.
+ * The mutex must be held. */
+double get_quantile(struct histogram_s *histogram, double quantile)
+{
+  unsigned long long int rank = ceil(quantile * histogram->count);
+  unsigned long long int sum = 0;
+  unsigned int i;
+
+  for(i = 0; i < BUCKETS; i++)
+  {
+    sum += histogram->buckets[i];
+    if((sum > 0) && (sum >= rank))
+    {
+      break;
+    }
+  }
+  if((i >= BUCKETS - 1) || (get_bucket_limit(i) > histogram->maximum))
+  {
+    return(histogram->maximum);
+  }
+  return(get_bucket_limit(i));
+}
+
+void timing_get(timing_t timing,
+                timing_stage_t stage,
+                unsigned long long int *count,
+                double *mean,
+                double *p50,
+                double *p99,
+                double *maximum)
+{
+  struct histogram_s *histogram = &timing->histograms[stage];
+
+  pthread_mutex_lock(&timing->mutex);
+  *count = histogram->count;
+  *mean = (histogram->count > 0) ? histogram->sum / histogram->count : 0;
+  *p50 = get_quantile(histogram, 0.5);
+  *p99 = get_quantile(histogram, 0.99);
+  *maximum = histogram->maximum;
+  pthread_mutex_unlock(&timing->mutex);
+}
+
+float timing_get_realtime_margin(timing_t timing)
+{
+  double busy;
+  float margin = 0;
+
+  pthread_mutex_lock(&timing->mutex);
+  busy = timing->histograms[TIMING_FRONTEND].sum +
+    timing->histograms[TIMING_FRAMING].sum;
+  if(timing->signal > 0)
+  {
+    margin = 1 - busy / timing->signal;
+  }
+  pthread_mutex_unlock(&timing->mutex);
+
+  return(margin);
+}
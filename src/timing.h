@@ -0,0 +1,94 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIMING_H
+#define TIMING_H
+
+/* Stages of the processing timed when the library is built with
+ * --enable-timing */
+typedef enum
+  {
+    /* Reading or writing samples from or to the radio */
+    TIMING_RADIO,
+    /* Conversion, frequency shift and resampling */
+    TIMING_FRONTEND,
+    /* Frame generation, or frame synchronization and decoding (including the
+     * data callbacks called by the frame synchronizer) */
+    TIMING_FRAMING,
+    /* Data callback */
+    TIMING_CALLBACK,
+    TIMING_STAGES
+  } timing_stage_t;
+
+/* Histograms of the processing times of the stages.
+ * The measures can be added by several threads. */
+typedef struct timing_s *timing_t;
+
+#ifdef ENABLE_TIMING
+#define TIMING_START(start) double start = timing_now()
+#define TIMING_STOP(timing, stage, start) \
+  timing_add(timing, stage, timing_now() - start)
+#define TIMING_SIGNAL(timing, samples, sample_rate) \
+  timing_add_signal(timing, (double) (samples) / (sample_rate))
+#else
+#define TIMING_START(start)
+#define TIMING_STOP(timing, stage, start)
+#define TIMING_SIGNAL(timing, samples, sample_rate)
+#endif
+
+/* Create empty histograms.
+ * If the creation fails, the function returns NULL. */
+timing_t timing_create();
+
+/* Destroy histograms */
+void timing_free(timing_t timing);
+
+/* Empty the histograms */
+void timing_reset(timing_t timing);
+
+/* Get the time of a monotonic clock in seconds */
+double timing_now();
+
+/* Add a processing time of 'seconds' to the histogram of 'stage' */
+void timing_add(timing_t timing, timing_stage_t stage, double seconds);
+
+/* Add 'seconds' to the duration of the signal processed */
+void timing_add_signal(timing_t timing, double seconds);
+
+/* Get the name of a stage */
+const char * timing_get_name(timing_stage_t stage);
+
+/* Get the number of measures, the mean, median, 99th percentile and maximum
+ * processing times of a stage, in seconds. The percentiles are rounded up to
+ * the upper bound of their bucket (at most 25% wide). */
+void timing_get(timing_t timing,
+                timing_stage_t stage,
+                unsigned long long int *count,
+                double *mean,
+                double *p50,
+                double *p99,
+                double *maximum);
+
+/* Get the fraction of the duration of the signal which was not used by the
+ * frontend and framing stages. It is negative when the processing is slower
+ * than real time. */
+float timing_get_realtime_margin(timing_t timing);
+
+#endif
@@ -0,0 +1,358 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+#define LINKS 4
+#define IDLE_TRANSFERS 3
+
+struct context_s
+{
+  unsigned char data[128];
+  unsigned int size;
+  unsigned int index;
+};
+
+int read_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int size = payload_size;
+
+  if(ctx->index == ctx->size)
+  {
+    return(-1);
+  }
+  if(ctx->index + size > ctx->size)
+  {
+    size = ctx->size - ctx->index;
+  }
+  memcpy(payload, ctx->data + ctx->index, size);
+  ctx->index += size;
+
+  return(size);
+}
+
+int write_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  /* Note: The callback of a real application would make sure that it can write
+   * all the payload without buffer overflow.
+   */
+  memcpy(ctx->data + ctx->size, payload, payload_size);
+  ctx->size += payload_size;
+
+  return(payload_size);
+}
+
+void * run(void *arg)
+{
+  dsss_transfer_start((dsss_transfer_t) arg);
+
+  return(NULL);
+}
+
+/* A transmitter that never has data to send, it runs until it is stopped */
+struct idle_s
+{
+  dsss_transfer_t transfer;
+  pthread_t thread;
+  atomic_uint calls;
+  atomic_int finished;
+};
+
+int idle_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct idle_s *idle = (struct idle_s *) context;
+
+  atomic_fetch_add(&idle->calls, 1);
+
+  return(0);
+}
+
+void * run_idle(void *arg)
+{
+  struct idle_s *idle = (struct idle_s *) arg;
+
+  dsss_transfer_start(idle->transfer);
+  atomic_store(&idle->finished, 1);
+
+  return(NULL);
+}
+
+int start_idle(struct idle_s *idle, char *radio)
+{
+  bzero(idle, sizeof(struct idle_s));
+  idle->transfer = dsss_transfer_create_callback(radio,
+                                                 1,
+                                                 idle_data,
+                                                 idle,
+                                                 2000000,
+                                                 1200,
+                                                 434000000,
+                                                 0,
+                                                 "0",
+                                                 0,
+                                                 64,
+                                                 "h128",
+                                                 "none",
+                                                 NULL,
+                                                 NULL,
+                                                 0,
+                                                 0);
+  if(idle->transfer == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(0);
+  }
+  if(pthread_create(&idle->thread, NULL, run_idle, idle) != 0)
+  {
+    fprintf(stderr, "Error: Failed to start thread\n");
+    return(0);
+  }
+  /* Wait until the transfer is running */
+  while(atomic_load(&idle->calls) == 0)
+  {
+    usleep(1000);
+  }
+
+  return(1);
+}
+
+/* Check whether a transfer is still running after some time, or whether it
+ * finished before the timeout (in ms) */
+int is_running(struct idle_s *idle, unsigned int timeout)
+{
+  unsigned int calls = atomic_load(&idle->calls);
+  unsigned int i;
+
+  for(i = 0; i < timeout; i++)
+  {
+    if(atomic_load(&idle->finished))
+    {
+      return(0);
+    }
+    usleep(1000);
+  }
+
+  return(atomic_load(&idle->calls) != calls);
+}
+
+void finish_idle(struct idle_s *idle)
+{
+  dsss_transfer_stop(idle->transfer);
+  pthread_join(idle->thread, NULL);
+  dsss_transfer_free(idle->transfer);
+}
+
+int test_stop()
+{
+  struct idle_s idles[IDLE_TRANSFERS];
+  char radio[32];
+  unsigned int i;
+  int ok = 1;
+
+  fprintf(stderr, "Test: Stop one transfer among several\n");
+
+  for(i = 0; i < IDLE_TRANSFERS; i++)
+  {
+    snprintf(radio, sizeof(radio), "loopback=stop%u", i);
+    if(!start_idle(&idles[i], radio))
+    {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  dsss_transfer_stop(idles[0].transfer);
+  if(is_running(&idles[0], 5000))
+  {
+    fprintf(stderr, "Error: The stopped transfer is still running\n");
+    ok = 0;
+  }
+  for(i = 1; i < IDLE_TRANSFERS; i++)
+  {
+    if(!is_running(&idles[i], 100))
+    {
+      fprintf(stderr, "Error: Transfer %u was stopped with another one\n", i);
+      ok = 0;
+    }
+  }
+
+  for(i = 0; i < IDLE_TRANSFERS; i++)
+  {
+    finish_idle(&idles[i]);
+  }
+
+  return(ok);
+}
+
+int test_stop_all()
+{
+  struct idle_s idles[IDLE_TRANSFERS];
+  struct idle_s late;
+  char radio[32];
+  unsigned int i;
+  int ok = 1;
+
+  fprintf(stderr, "Test: Stop all the transfers, then start a new one\n");
+
+  for(i = 0; i < IDLE_TRANSFERS; i++)
+  {
+    snprintf(radio, sizeof(radio), "loopback=stop-all%u", i);
+    if(!start_idle(&idles[i], radio))
+    {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  dsss_transfer_stop_all();
+
+  /* A transfer started after dsss_transfer_stop_all() must run, and starting
+   * it must not cancel the stop of the transfers that were already running */
+  if(!start_idle(&late, "loopback=stop-all-late"))
+  {
+    exit(EXIT_FAILURE);
+  }
+  for(i = 0; i < IDLE_TRANSFERS; i++)
+  {
+    if(is_running(&idles[i], 5000))
+    {
+      fprintf(stderr, "Error: Transfer %u was not stopped\n", i);
+      ok = 0;
+    }
+  }
+  if(!is_running(&late, 100))
+  {
+    fprintf(stderr, "Error: The transfer started after the stop was stopped\n");
+    ok = 0;
+  }
+
+  for(i = 0; i < IDLE_TRANSFERS; i++)
+  {
+    finish_idle(&idles[i]);
+  }
+  finish_idle(&late);
+
+  return(ok);
+}
+
+int main()
+{
+  dsss_transfer_t transfers[2 * LINKS];
+  struct context_s contexts[2 * LINKS];
+  pthread_t threads[2 * LINKS];
+  char radio[32];
+  char id[5];
+  unsigned int i;
+  int ok = 1;
+
+  fprintf(stderr, "Test: Run several transfers at the same time\n");
+
+  for(i = 0; i < 2 * LINKS; i++)
+  {
+    /* The even transfers send a different message on each link, the odd
+     * transfers receive them */
+    bzero(&contexts[i], sizeof(struct context_s));
+    if(i % 2 == 0)
+    {
+      snprintf(contexts[i].data,
+               sizeof(contexts[i].data),
+               "This is the test transmission number %u.",
+               i / 2);
+      contexts[i].size = strlen(contexts[i].data);
+    }
+    snprintf(radio, sizeof(radio), "loopback=test%u", i / 2);
+    snprintf(id, sizeof(id), "ID%02u", i / 2);
+    transfers[i] = dsss_transfer_create_callback(radio,
+                                                 i % 2 == 0,
+                                                 (i % 2 == 0) ?
+                                                 read_data :
+                                                 write_data,
+                                                 &contexts[i],
+                                                 2000000,
+                                                 1200,
+                                                 434000000,
+                                                 0,
+                                                 "0",
+                                                 0,
+                                                 64,
+                                                 "h128",
+                                                 "none",
+                                                 id,
+                                                 NULL,
+                                                 0,
+                                                 0);
+    if(transfers[i] == NULL)
+    {
+      fprintf(stderr, "Error: Failed to initialize transfer\n");
+      return(EXIT_FAILURE);
+    }
+  }
+
+  for(i = 0; i < 2 * LINKS; i++)
+  {
+    if(pthread_create(&threads[i], NULL, run, transfers[i]) != 0)
+    {
+      fprintf(stderr, "Error: Failed to start thread\n");
+      return(EXIT_FAILURE);
+    }
+  }
+  for(i = 0; i < 2 * LINKS; i++)
+  {
+    pthread_join(threads[i], NULL);
+    dsss_transfer_free(transfers[i]);
+  }
+
+  for(i = 0; i < LINKS; i++)
+  {
+    if((contexts[2 * i + 1].size != contexts[2 * i].size) ||
+       (memcmp(contexts[2 * i + 1].data,
+               contexts[2 * i].data,
+               contexts[2 * i].size) != 0))
+    {
+      fprintf(stderr, "Error: Wrong data received on link %u\n", i);
+      ok = 0;
+    }
+  }
+
+  if(!test_stop())
+  {
+    ok = 0;
+  }
+  if(!test_stop_all())
+  {
+    ok = 0;
+  }
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,198 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+struct context_s
+{
+  unsigned char data[128];
+  unsigned int size;
+  unsigned int index;
+  char id[5];
+};
+
+int read_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int size = payload_size;
+
+  if(ctx->index == ctx->size)
+  {
+    return(-1);
+  }
+  if(ctx->index + size > ctx->size)
+  {
+    size = ctx->size - ctx->index;
+  }
+  memcpy(payload, ctx->data + ctx->index, size);
+  ctx->index += size;
+
+  return(size);
+}
+
+int write_data(void *context,
+               char *id,
+               unsigned char *payload,
+               unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  /* Note: The callback of a real application would make sure that it can write
+   * all the payload without buffer overflow.
+   */
+  memcpy(ctx->data + ctx->size, payload, payload_size);
+  ctx->size += payload_size;
+  strcpy(ctx->id, id);
+
+  return(payload_size);
+}
+
+int send_message(char *message, char *id)
+{
+  dsss_transfer_t send;
+  struct context_s context;
+
+  bzero(&context, sizeof(context));
+  strcpy(context.data, message);
+  context.size = strlen(message);
+  send = dsss_transfer_create_callback("io",
+                                       1,
+                                       read_data,
+                                       &context,
+                                       2000000,
+                                       1200,
+                                       434000000,
+                                       0,
+                                       "0",
+                                       0,
+                                       64,
+                                       "h128",
+                                       "none",
+                                       id,
+                                       NULL,
+                                       0,
+                                       0);
+  if(send == NULL)
+  {
+    return(0);
+  }
+  dsss_transfer_start(send);
+  dsss_transfer_free(send);
+
+  return(1);
+}
+
+int main()
+{
+  dsss_transfer_t receive;
+  struct context_s context1;
+  struct context_s context2;
+  dsss_transfer_id_stats_t stats[4];
+  char message1[] = "This is a test transmission using dsss-transfer.";
+  char message2[] = "This is another transmission on the same channel.";
+  char samples_file[] = "/tmp/samples.XXXXXX";
+  int samples_fd = mkstemp(samples_file);
+  unsigned int n;
+  int ok = 0;
+
+  fprintf(stderr, "Test: Receive several transfer ids at once\n");
+
+  if(samples_fd == -1)
+  {
+    fprintf(stderr, "Error: Failed to create temporary file\n");
+    return(EXIT_FAILURE);
+  }
+
+  if(dup2(samples_fd, STDIN_FILENO) == -1)
+  {
+    fprintf(stderr, "Error: Failed to redirect standard input\n");
+    return(EXIT_FAILURE);
+  }
+  if(dup2(samples_fd, STDOUT_FILENO) == -1)
+  {
+    fprintf(stderr, "Error: Failed to redirect standard output\n");
+    return(EXIT_FAILURE);
+  }
+
+  if(!send_message(message1, "id1") || !send_message(message2, "id2"))
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+
+  lseek(samples_fd, 0, SEEK_SET);
+  bzero(&context1, sizeof(context1));
+  bzero(&context2, sizeof(context2));
+  receive = dsss_transfer_create_callback("io",
+                                          0,
+                                          NULL,
+                                          NULL,
+                                          2000000,
+                                          1200,
+                                          434000000,
+                                          0,
+                                          "0",
+                                          0,
+                                          64,
+                                          "h128",
+                                          "none",
+                                          "",
+                                          NULL,
+                                          0,
+                                          0);
+  if(receive == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+  if((dsss_transfer_add_id_callback(receive, "id1", write_data, &context1) < 0) ||
+     (dsss_transfer_add_id_callback(receive, NULL, write_data, &context2) < 0))
+  {
+    fprintf(stderr, "Error: Failed to add id callbacks\n");
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_start(receive);
+  n = dsss_transfer_get_id_stats(receive, stats, 4);
+  dsss_transfer_free(receive);
+
+  ok = ((strcmp(message1, context1.data) == 0) &&
+        (strcmp(message2, context2.data) == 0) &&
+        (strcmp(context2.id, "id2") == 0) &&
+        (n == 2) &&
+        (strcmp(stats[0].id, "id1") == 0) &&
+        (stats[0].bytes == strlen(message1)) &&
+        (strcmp(stats[1].id, "id2") == 0) &&
+        (stats[1].bytes == strlen(message2)));
+  close(samples_fd);
+  unlink(samples_file);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,209 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "kernels.h"
+
+/* Compare the implementations of the kernels supported by the processor
+ * with the scalar one. The sizes are not multiples of the vector sizes,
+ * so that the code for the last samples is tested too. */
+
+#define SAMPLES_SIZE 1021
+#define COUNT (2 * SAMPLES_SIZE)
+
+int compare_floats(char *what, const float *x, const float *y, float tolerance)
+{
+  unsigned int i;
+
+  for(i = 0; i < COUNT; i++)
+  {
+    if(fabsf(x[i] - y[i]) > tolerance)
+    {
+      fprintf(stderr, "  %s: %f instead of %f at %u\n", what, x[i], y[i], i);
+      return(0);
+    }
+  }
+  return(1);
+}
+
+/* The rounding can differ by 1 when a value is exactly between two
+ * integers */
+int compare_integers(char *what, const int *x, const int *y)
+{
+  unsigned int i;
+
+  for(i = 0; i < COUNT; i++)
+  {
+    if(abs(x[i] - y[i]) > 1)
+    {
+      fprintf(stderr, "  %s: %d instead of %d at %u\n", what, x[i], y[i], i);
+      return(0);
+    }
+  }
+  return(1);
+}
+
+int check(const kernel_functions_t *tested, const kernel_functions_t *scalar)
+{
+  float input[COUNT];
+  float output[COUNT];
+  float reference[COUNT];
+  short int s16[COUNT];
+  signed char s8[COUNT];
+  int converted[COUNT];
+  int expected[COUNT];
+  mixer_t mixer;
+  float peak;
+  float reference_peak;
+  float sum;
+  float reference_sum;
+  float dot[2];
+  float reference_dot[2];
+  unsigned int dot_counts[4] = { 8, 24, 56, COUNT - 2 };
+  unsigned int i;
+  int ok = 1;
+
+  /* Values out of the [-1, 1] range test the saturation */
+  for(i = 0; i < COUNT; i++)
+  {
+    input[i] = 2.5 * ((float) rand() / RAND_MAX) - 1.25;
+    s16[i] = rand();
+    s8[i] = rand();
+  }
+
+  tested->s16_to_float(s16, output, COUNT, 0.5);
+  scalar->s16_to_float(s16, reference, COUNT, 0.5);
+  ok &= compare_floats("s16_to_float", output, reference, 0);
+
+  tested->s8_to_float(s8, output, COUNT, 2);
+  scalar->s8_to_float(s8, reference, COUNT, 2);
+  ok &= compare_floats("s8_to_float", output, reference, 0);
+
+  tested->float_to_s16(input, s16, COUNT, 1);
+  for(i = 0; i < COUNT; i++)
+  {
+    converted[i] = s16[i];
+  }
+  scalar->float_to_s16(input, s16, COUNT, 1);
+  for(i = 0; i < COUNT; i++)
+  {
+    expected[i] = s16[i];
+  }
+  ok &= compare_integers("float_to_s16", converted, expected);
+
+  tested->float_to_s8(input, s8, COUNT, 0.9);
+  for(i = 0; i < COUNT; i++)
+  {
+    converted[i] = s8[i];
+  }
+  scalar->float_to_s8(input, s8, COUNT, 0.9);
+  for(i = 0; i < COUNT; i++)
+  {
+    expected[i] = s8[i];
+  }
+  ok &= compare_integers("float_to_s8", converted, expected);
+
+  tested->scale(input, output, COUNT, 0.75);
+  scalar->scale(input, reference, COUNT, 0.75);
+  ok &= compare_floats("scale", output, reference, 0);
+
+  sum = tested->power(input, SAMPLES_SIZE, &peak);
+  reference_sum = scalar->power(input, SAMPLES_SIZE, &reference_peak);
+  if((fabsf(sum - reference_sum) > 1e-4 * reference_sum) ||
+     (peak != reference_peak))
+  {
+    fprintf(stderr,
+            "  power: %f and %f instead of %f and %f\n",
+            sum,
+            peak,
+            reference_sum,
+            reference_peak);
+    ok = 0;
+  }
+
+  /* Two calls, to check that the phase continues */
+  mixer_init(&mixer, 0.3);
+  tested->mix(input, output, 500, &mixer, 1);
+  tested->mix(input + 1000, output + 1000, SAMPLES_SIZE - 500, &mixer, 1);
+  mixer_init(&mixer, 0.3);
+  scalar->mix(input, reference, 500, &mixer, 1);
+  scalar->mix(input + 1000, reference + 1000, SAMPLES_SIZE - 500, &mixer, 1);
+  ok &= compare_floats("mix", output, reference, 1e-4);
+
+  /* Dot products with and without the last partial vectors */
+  for(i = 0; i < 4; i++)
+  {
+    tested->dot(input, input + 1, dot_counts[i], dot);
+    scalar->dot(input, input + 1, dot_counts[i], reference_dot);
+    if((fabsf(dot[0] - reference_dot[0]) > 1e-3) ||
+       (fabsf(dot[1] - reference_dot[1]) > 1e-3))
+    {
+      fprintf(stderr,
+              "  dot: %f and %f instead of %f and %f for %u floats\n",
+              dot[0],
+              dot[1],
+              reference_dot[0],
+              reference_dot[1],
+              dot_counts[i]);
+      ok = 0;
+    }
+  }
+
+  return(ok);
+}
+
+int main()
+{
+  const kernel_functions_t *scalar = kernels_get(KERNEL_SET_SCALAR);
+  const kernel_functions_t *tested;
+  kernel_set_t set;
+  int ok = 1;
+
+  fprintf(stderr, "Test: Kernels\n");
+
+  kernels_init();
+  if(kernels_get(kernels_get_selected()) == NULL)
+  {
+    fprintf(stderr, "  No implementation selected\n");
+    ok = 0;
+  }
+  for(set = KERNEL_SET_SCALAR; set < KERNEL_SETS; set++)
+  {
+    tested = kernels_get(set);
+    if(tested == NULL)
+    {
+      continue;
+    }
+    fprintf(stderr, "  %s\n", kernels_get_name(set));
+    ok &= check(tested, scalar);
+  }
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
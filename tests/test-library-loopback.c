@@ -0,0 +1,173 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dsss-transfer.h"
+
+struct context_s
+{
+  unsigned char data[128];
+  unsigned int size;
+  unsigned int index;
+};
+
+int read_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int size = payload_size;
+
+  if(ctx->index == ctx->size)
+  {
+    return(-1);
+  }
+  if(ctx->index + size > ctx->size)
+  {
+    size = ctx->size - ctx->index;
+  }
+  memcpy(payload, ctx->data + ctx->index, size);
+  ctx->index += size;
+
+  return(size);
+}
+
+int write_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  /* Note: The callback of a real application would make sure that it can write
+   * all the payload without buffer overflow.
+   */
+  memcpy(ctx->data + ctx->size, payload, payload_size);
+  ctx->size += payload_size;
+
+  return(payload_size);
+}
+
+void * receive(void *arg)
+{
+  dsss_transfer_start((dsss_transfer_t) arg);
+
+  return(NULL);
+}
+
+int main()
+{
+  dsss_transfer_t send;
+  dsss_transfer_t receive_transfer;
+  dsss_transfer_t second_receive;
+  struct context_s send_context;
+  struct context_s receive_context;
+  char message[] = "This is a test transmission using dsss-transfer.";
+  pthread_t thread;
+  int ok = 0;
+
+  fprintf(stderr, "Test: Send and receive using a loopback\n");
+
+  bzero(&send_context, sizeof(send_context));
+  strcpy(send_context.data, message);
+  send_context.size = strlen(message);
+  bzero(&receive_context, sizeof(receive_context));
+
+  receive_transfer = dsss_transfer_create_callback("loopback=test",
+                                                   0,
+                                                   write_data,
+                                                   &receive_context,
+                                                   2000000,
+                                                   1200,
+                                                   434000000,
+                                                   0,
+                                                   "0",
+                                                   0,
+                                                   64,
+                                                   "h128",
+                                                   "none",
+                                                   "",
+                                                   NULL,
+                                                   0,
+                                                   0);
+  send = dsss_transfer_create_callback("loopback=test",
+                                       1,
+                                       read_data,
+                                       &send_context,
+                                       2000000,
+                                       1200,
+                                       434000000,
+                                       0,
+                                       "0",
+                                       0,
+                                       64,
+                                       "h128",
+                                       "none",
+                                       "",
+                                       NULL,
+                                       0,
+                                       0);
+  if((receive_transfer == NULL) || (send == NULL))
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+  /* Only one receiver can use the link */
+  second_receive = dsss_transfer_create_callback("loopback=test",
+                                                 0,
+                                                 write_data,
+                                                 &receive_context,
+                                                 2000000,
+                                                 1200,
+                                                 434000000,
+                                                 0,
+                                                 "0",
+                                                 0,
+                                                 64,
+                                                 "h128",
+                                                 "none",
+                                                 "",
+                                                 NULL,
+                                                 0,
+                                                 0);
+  if(second_receive != NULL)
+  {
+    fprintf(stderr, "Error: Second receiver accepted\n");
+    return(EXIT_FAILURE);
+  }
+  if(pthread_create(&thread, NULL, receive, receive_transfer) != 0)
+  {
+    fprintf(stderr, "Error: Failed to start thread\n");
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_start(send);
+  pthread_join(thread, NULL);
+  dsss_transfer_free(send);
+  dsss_transfer_free(receive_transfer);
+
+  ok = (strcmp(message, receive_context.data) == 0);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,171 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+struct context_s
+{
+  unsigned char data[128];
+  unsigned int size;
+  unsigned int index;
+};
+
+int read_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int size = payload_size;
+
+  if(ctx->index == ctx->size)
+  {
+    return(-1);
+  }
+  if(ctx->index + size > ctx->size)
+  {
+    size = ctx->size - ctx->index;
+  }
+  memcpy(payload, ctx->data + ctx->index, size);
+  ctx->index += size;
+
+  return(size);
+}
+
+int write_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  /* Note: The callback of a real application would make sure that it can write
+   * all the payload without buffer overflow.
+   */
+  memcpy(ctx->data + ctx->size, payload, payload_size);
+  ctx->size += payload_size;
+
+  return(payload_size);
+}
+
+dsss_transfer_t create(char *radio, unsigned char emit, char *id, void *context)
+{
+  return(dsss_transfer_create_callback(radio,
+                                       emit,
+                                       emit ? read_data : write_data,
+                                       context,
+                                       2000000,
+                                       1200,
+                                       434000000,
+                                       0,
+                                       "0",
+                                       0,
+                                       64,
+                                       "h128",
+                                       "none",
+                                       id,
+                                       NULL,
+                                       0,
+                                       0));
+}
+
+int main()
+{
+  dsss_transfer_t transfer;
+  struct context_s send_context;
+  struct context_s receive_context;
+  dsss_transfer_stats_t sent;
+  dsss_transfer_stats_t received;
+  dsss_transfer_stats_t foreign;
+  char message[] = "This is a test transmission using dsss-transfer.";
+  char samples_file[] = "/tmp/samples.XXXXXX";
+  int samples_fd = mkstemp(samples_file);
+  char radio[64];
+  int ok = 0;
+
+  fprintf(stderr, "Test: Statistics of a transfer\n");
+
+  if(samples_fd == -1)
+  {
+    fprintf(stderr, "Error: Failed to create temporary file\n");
+    return(EXIT_FAILURE);
+  }
+  close(samples_fd);
+  snprintf(radio, sizeof(radio), "file=%s", samples_file);
+
+  bzero(&send_context, sizeof(send_context));
+  strcpy(send_context.data, message);
+  send_context.size = strlen(message);
+  transfer = create(radio, 1, "ABCD", &send_context);
+  if(transfer == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_start(transfer);
+  dsss_transfer_get_stats(transfer, &sent);
+  dsss_transfer_free(transfer);
+
+  bzero(&receive_context, sizeof(receive_context));
+  transfer = create(radio, 0, "ABCD", &receive_context);
+  if(transfer == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_start(transfer);
+  dsss_transfer_get_stats(transfer, &received);
+  dsss_transfer_free(transfer);
+
+  /* The frames for another id are only counted */
+  bzero(&receive_context, sizeof(receive_context));
+  transfer = create(radio, 0, "WXYZ", &receive_context);
+  if(transfer == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_start(transfer);
+  dsss_transfer_get_stats(transfer, &foreign);
+  dsss_transfer_free(transfer);
+  unlink(samples_file);
+
+  ok = (sent.frames == 1) &&
+    (sent.bytes == strlen(message)) &&
+    (sent.samples > 0) &&
+    (received.frames == 1) &&
+    (received.bytes == strlen(message)) &&
+    (received.samples == sent.samples) &&
+    (received.header_errors == 0) &&
+    (received.payload_errors == 0) &&
+    (received.foreign_frames == 0) &&
+    (received.evm_worst >= received.evm_mean) &&
+    (foreign.frames == 0) &&
+    (foreign.bytes == 0) &&
+    (foreign.foreign_frames == 1) &&
+    (receive_context.size == 0);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -24,6 +24,7 @@ DSSS_TRANSFER=../src/dsss-transfer
 MESSAGE=$(mktemp -t message.XXXXXX)
 DECODED=$(mktemp -t decoded.XXXXXX)
 SAMPLES=$(mktemp -t samples.XXXXXX)
+DUMP=$(mktemp -t dump.XXXXXX)
 
 echo "This is a test transmission using dsss-transfer." > ${MESSAGE}
 
@@ -86,6 +87,21 @@ check_nok_io "Wrong frequency offset 200000 250000" "-o 200000" "-o 250000"
 check_ok_io "Sample rate 4000000" "-s 4000000" "-s 4000000"
 check_ok_file "Sample rate 10000000" "-s 10000000" "-s 10000000"
 check_nok_io "Wrong sample rate 1000000 2000000" "-s 1000000" "-s 2000000"
+check_ok_io "Pipelined receiver" "" "-p 200"
+check_ok_file "Pipelined receiver, bit rate 9600" "-b 9600" "-b 9600 -p 500"
+check_ok_io "Sample format CS16" "-F CS16 -o 100000" "-F CS16 -o 100000"
+check_ok_file "Sample format CS8" "-F CS8 -o 100000" "-F CS8 -o 100000 -p 200"
+check_ok_io "Native sample format of the io radio" "-F native" "-F CF32"
+check_ok_file "Fused front end" "-o 200000" "-o 200000 -D"
+check_ok_io "Fused front end, sample format CS16" "-F CS16 -o -300000" "-F CS16 -o -300000 -D"
+check_ok_io "Channels 16, sub-band 2" "-o 250000" "-m 16:-1,2 -j 2"
+check_ok_file "Channels 32, sub-band -5" "-o -312500" "-m 32:-5"
+check_ok_io "Squelch 6 dB" "" "-S 6"
+check_ok_file "Squelch 3 dB, pipelined receiver" "-b 1200" "-b 1200 -S 3 -p 200"
+check_ok_io "Pipelined transmitter" "-p 200" ""
+check_ok_file "Pipelined transmitter and receiver, CS8" "-p 100 -F CS8 -o 100000" "-p 100 -F CS8 -o 100000"
+check_ok_io "Delivery queue" "" "-q 65536"
+check_ok_file "Delivery queue, pipelined receiver" "-b 1200" "-b 1200 -p 200 -q 4096:drop-oldest"
 check_ok_io "Spreading factor 2" "-n 2" "-n 2"
 check_ok_file "Spreading factor 10" "-n 10" "-n 10"
 check_nok_io "Wrong spreading factor 30 29" "-n 30" "-n 29"
@@ -93,6 +109,47 @@ check_ok_io "FEC Hamming(7/4)" "-e h74" "-e h74"
 check_ok_file "FEC Golay(24/12) and repeat(3)" "-e g2412,rep3" "-e g2412,rep3"
 check_ok_io "Id a1B2" "-i a1B2" "-i a1B2"
 check_nok_file "Wrong id ABCD ABC" "-i ABCD" "-i ABC"
+
+echo "Test: Recording read from a pipe"
+${DSSS_TRANSFER} -t -r file=${SAMPLES} -o 100000 ${MESSAGE}
+cat ${SAMPLES} | ${DSSS_TRANSFER} -r file=/dev/stdin -o 100000 ${DECODED}
+diff -q ${MESSAGE} ${DECODED} > /dev/null
+
+echo "Test: Dump converted to CS16"
+${DSSS_TRANSFER} -t -r io -o 100000 ${MESSAGE} > ${SAMPLES}
+${DSSS_TRANSFER} -r io -o 100000 -d ${DUMP}:CS16 /dev/null < ${SAMPLES}
+${DSSS_TRANSFER} -r file=${DUMP} -F CS16 -o 100000 ${DECODED}
+diff -q ${MESSAGE} ${DECODED} > /dev/null
+
+echo "Test: Recorder"
+${DSSS_TRANSFER} -t -r io -b 9600 ${MESSAGE} > ${SAMPLES}
+${DSSS_TRANSFER} -r io -b 9600 -R ${DUMP}:0.5:all /dev/null < ${SAMPLES}
+${DSSS_TRANSFER} -r file=${DUMP}.1 -b 9600 ${DECODED}
+diff -q ${MESSAGE} ${DECODED} > /dev/null
+rm -f ${DUMP}.1
+
+echo "Test: Id ABCD after frames for id EFGH"
+echo "Not for ABCD." | ${DSSS_TRANSFER} -t -r io -i EFGH > ${SAMPLES}
+${DSSS_TRANSFER} -t -r io -i ABCD ${MESSAGE} >> ${SAMPLES}
+${DSSS_TRANSFER} -r io -i ABCD -v ${DECODED} < ${SAMPLES} 2> ${DUMP}
+diff -q ${MESSAGE} ${DECODED} > /dev/null
+# The payload of the frame for EFGH must be skipped without being decoded
+grep -q "Info: [1-9][0-9]* frames for other ids skipped" ${DUMP}
+
+echo "Test: Data arriving late on standard input"
+(sleep 1; cat ${MESSAGE}) | ${DSSS_TRANSFER} -t -r io > ${SAMPLES}
+${DSSS_TRANSFER} -r io ${DECODED} < ${SAMPLES}
+diff -q ${MESSAGE} ${DECODED} > /dev/null
+
+echo "Test: Data arriving in pieces grouped in frames"
+(head -c 100 ${MESSAGE}; sleep 0.2; tail -c +101 ${MESSAGE}) | \
+    ${DSSS_TRANSFER} -t -r io -P 4000:500 > ${SAMPLES}
+${DSSS_TRANSFER} -r io ${DECODED} < ${SAMPLES}
+diff -q ${MESSAGE} ${DECODED} > /dev/null
+
+check_ok_io "Payload size 32" "-P 32" ""
+check_ok_io "Short blocks and frames" "-L 10:20" "-L 10"
+
 check_ok_file "Audio frequency 1500" \
               "-a -s 48000 -f 1500 -b 30" \
               "-a -s 48000 -f 1500 -b 30"
@@ -102,11 +159,47 @@ check_nok_io "Wrong audio frequency 1500 2500" \
 check_ok_io "Audio gain -20" \
             "-a -s 48000 -f 1500 -b 30 -g -20" \
             "-a -s 48000 -f 1500 -b 30"
+check_ok_io "Audio float samples" \
+            "-a -s 48000 -f 1500 -b 30 -F F32" \
+            "-a -s 48000 -f 1500 -b 30 -F F32"
+echo "Test: Wrong audio sample format CF32"
+if ${DSSS_TRANSFER} -t -r io -a -s 48000 -f 1500 -b 30 -F CF32 ${MESSAGE} \
+                    > /dev/null 2>&1
+then
+    exit 1
+fi
+check_ok_io "Direct audio modem" \
+            "-A -s 48000 -f 1500 -b 30" \
+            "-A -s 48000 -f 1500 -b 30 -D"
+check_ok_io "Direct audio modem to Hilbert audio modem" \
+            "-A -s 48000 -f 1500 -b 30" \
+            "-a -s 48000 -f 1500 -b 30"
+check_ok_io "Hilbert audio modem to direct audio modem" \
+            "-a -s 48000 -f 1500 -b 30" \
+            "-A -s 48000 -f 1500 -b 30"
 
 dd if=/dev/random of=${MESSAGE} bs=1000 count=200 status=none
 check_ok_file "Bit rate 8000000, sample rate 100000000, spreading 8" \
               "-s 100000000 -n 8 -b 8000000" \
               "-s 100000000 -n 8 -b 8000000"
 
-rm -f ${MESSAGE} ${DECODED} ${SAMPLES}
+check_ok_file "Parallel decoding, bit rate 8000000, sample rate 100000000" \
+              "-s 100000000 -n 8 -b 8000000" \
+              "-s 100000000 -n 8 -b 8000000 -j 4"
+check_ok_file "Parallel decoding, payload size 20000" \
+              "-s 100000000 -n 8 -b 8000000 -P 20000" \
+              "-s 100000000 -n 8 -b 8000000 -j 4"
+check_ok_file "Parallel decoding, known payload size 20000" \
+              "-s 100000000 -n 8 -b 8000000 -P 20000" \
+              "-s 100000000 -n 8 -b 8000000 -P 20000 -j 4"
+check_ok_file "Parallel decoding, long frames of the transmitter" \
+              "-s 8000000 -n 8 -b 320000 -F CS8 -L 50:1000" \
+              "-s 8000000 -n 8 -b 320000 -F CS8 -j 4"
+# The recording stops right after the frame, whose last samples are still
+# in the filters of the receiver at the end of the file
+check_ok_file "Parallel decoding, frame at the end of the recording" \
+              "" \
+              "-j 2"
+
+rm -f ${MESSAGE} ${DECODED} ${SAMPLES} ${DUMP}
 echo "All tests passed."